@@ -0,0 +1,187 @@
+#include "binaryio.h"
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+const size_t ALIGNMENT = 8;
+
+} // namespace
+
+MappedFile::MappedFile(const std::string& filename) : base(nullptr), length(0) {
+#ifdef _WIN32
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if (!in.is_open()) {
+        throw std::runtime_error("Cannot open file: " + filename);
+    }
+    copy.resize(static_cast<size_t>(in.tellg()));
+    in.seekg(0, std::ios::beg);
+    if (!in.read(copy.data(), copy.size())) {
+        throw std::runtime_error("Cannot read file: " + filename);
+    }
+    base = copy.data();
+    length = copy.size();
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open file: " + filename);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot read file: " + filename);
+    }
+    length = static_cast<size_t>(info.st_size);
+    if (length > 0) {
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Cannot map file: " + filename);
+        }
+        base = static_cast<const char*>(mapped);
+    }
+    close(fd); // the mapping stays valid without it
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (base != nullptr) {
+        munmap(const_cast<char*>(base), length);
+    }
+#endif
+}
+
+const size_t BinaryWriter::BUFFER_SIZE;
+const uint64_t BinaryWriter::HASH_SEED;
+
+uint64_t BinaryWriter::hashBytes(uint64_t hash, const char* bytes, size_t length) {
+    // FNV-1a over 8-byte words, then the bytes left over; the writer hashes
+    // whole buffers, so word boundaries fall in the same place on reading
+    const uint64_t prime = 1099511628211ULL;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        hash = (hash ^ word) * prime;
+    }
+    for (; i < length; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(bytes[i])) * prime;
+    }
+    return hash;
+}
+
+BinaryWriter::BinaryWriter(const std::string& filename)
+    : file(std::fopen(filename.c_str(), "wb")), path(filename), buffer(BUFFER_SIZE), used(0),
+      flushed(0), hash(HASH_SEED) {
+    if (file == nullptr) {
+        throw std::runtime_error("Cannot create file: " + filename);
+    }
+}
+
+BinaryWriter::~BinaryWriter() {
+    if (file != nullptr) {
+        std::fclose(file);
+    }
+}
+
+void BinaryWriter::flushBuffer() {
+    hash = hashBytes(hash, buffer.data(), used);
+    if (used > 0 && std::fwrite(buffer.data(), 1, used, file) != used) {
+        throw std::runtime_error("Cannot write file: " + path);
+    }
+    flushed += used;
+    used = 0;
+}
+
+void BinaryWriter::writeBytes(const void* bytes, size_t length) {
+    const char* in = static_cast<const char*>(bytes);
+    while (length > 0) {
+        size_t chunk = std::min(length, BUFFER_SIZE - used);
+        std::memcpy(buffer.data() + used, in, chunk);
+        used += chunk;
+        in += chunk;
+        length -= chunk;
+        if (used == BUFFER_SIZE) {
+            flushBuffer();
+        }
+    }
+}
+
+void BinaryWriter::writeString(const std::string& str) {
+    write<uint32_t>(static_cast<uint32_t>(str.size()));
+    writeBytes(str.data(), str.size());
+}
+
+void BinaryWriter::align() {
+    static const char zeros[ALIGNMENT] = {};
+    writeBytes(zeros, (ALIGNMENT - (flushed + used) % ALIGNMENT) % ALIGNMENT);
+}
+
+uint64_t BinaryWriter::checksum() {
+    flushBuffer();
+    return hash;
+}
+
+void BinaryWriter::close() {
+    flushBuffer();
+    bool failed = std::fflush(file) != 0;
+#ifdef _WIN32
+    failed = failed || _commit(_fileno(file)) != 0;
+#else
+    failed = failed || fsync(fileno(file)) != 0;
+#endif
+    failed = std::fclose(file) != 0 || failed;
+    file = nullptr;
+    if (failed) {
+        throw std::runtime_error("Cannot write file: " + path);
+    }
+}
+
+BinaryReader::BinaryReader(const std::string& filename)
+    : file(std::make_shared<MappedFile>(filename)), data(file->data()), dataSize(file->size()), cursor(0) {}
+
+void BinaryReader::require(uint64_t count, size_t size) const {
+    if (count > (dataSize - cursor) / size) {
+        throw std::runtime_error("Index file is truncated");
+    }
+}
+
+void BinaryReader::readBytes(void* out, size_t length) {
+    require(length);
+    if (length > 0) {
+        std::memcpy(out, data + cursor, length);
+    }
+    cursor += length;
+}
+
+const char* BinaryReader::take(size_t length) {
+    require(length);
+    const char* bytes = data + cursor;
+    cursor += length;
+    return bytes;
+}
+
+std::string BinaryReader::readString() {
+    uint32_t length = read<uint32_t>();
+    require(length);
+    std::string str(data + cursor, length);
+    cursor += length;
+    return str;
+}
+
+void BinaryReader::align() {
+    size_t padding = (ALIGNMENT - cursor % ALIGNMENT) % ALIGNMENT;
+    require(padding);
+    cursor += padding;
+}
\ No newline at end of file
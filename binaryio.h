@@ -0,0 +1,124 @@
+#ifndef BINARYIO_H
+#define BINARYIO_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+// A whole file mapped read-only, so every process serving the same index
+// shares one copy of it in the page cache. On Windows a mapped file cannot
+// be replaced while it is open, which saving relies on, so the file is read
+// into memory there instead.
+class MappedFile {
+private:
+    const char* base;
+    size_t length;
+    std::vector<char> copy; // Windows only
+    
+public:
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    const char* data() const { return base; }
+    size_t size() const { return length; }
+};
+
+// Buffered sequential writer for index files. Values go out in host byte
+// order, which the file header records, and a checksum of everything
+// written is kept for the trailer. Failures throw std::runtime_error.
+class BinaryWriter {
+private:
+    std::FILE* file;
+    std::string path;
+    std::vector<char> buffer;
+    size_t used;
+    uint64_t flushed;
+    uint64_t hash;
+    
+    void flushBuffer();
+    
+public:
+    static const size_t BUFFER_SIZE = 1 << 20; // a multiple of 8, see checksum()
+    static const uint64_t HASH_SEED = 14695981039346656037ULL;
+    
+    explicit BinaryWriter(const std::string& filename);
+    ~BinaryWriter(); // closes without syncing if close() was not called
+    
+    BinaryWriter(const BinaryWriter&) = delete;
+    BinaryWriter& operator=(const BinaryWriter&) = delete;
+    
+    void writeBytes(const void* bytes, size_t length);
+    template <typename T> void write(const T& value) { writeBytes(&value, sizeof(T)); }
+    template <typename T> void writeArray(const std::vector<T>& values) {
+        write<uint64_t>(values.size());
+        writeBytes(values.data(), values.size() * sizeof(T));
+    }
+    // Like writeArray, but the values start on an 8-byte boundary of the
+    // file, so a mapped reader can use them in place
+    template <typename T> void writeAligned(const T* values, size_t count) {
+        write<uint64_t>(count);
+        align();
+        writeBytes(values, count * sizeof(T));
+    }
+    void writeString(const std::string& str);
+    void align();
+    uint64_t checksum(); // of everything written so far; only at the end, since it flushes a partial buffer
+    void close();        // flushes and syncs to disk
+    
+    static uint64_t hashBytes(uint64_t hash, const char* bytes, size_t length);
+};
+
+// Reads a mapped index file. Arrays come out with a single copy each, or
+// none through view(); reading past the end throws std::runtime_error, so a
+// truncated file is caught rather than read as garbage.
+class BinaryReader {
+private:
+    std::shared_ptr<const MappedFile> file;
+    const char* data;
+    size_t dataSize;
+    size_t cursor;
+    
+    void require(uint64_t count, size_t size = 1) const;
+    
+public:
+    explicit BinaryReader(const std::string& filename);
+    
+    size_t position() const { return cursor; }
+    size_t size() const { return dataSize; }
+    const char* bytes() const { return data; }
+    // Whatever holds pointers from view() keeps this alive
+    const std::shared_ptr<const MappedFile>& mapping() const { return file; }
+    
+    void readBytes(void* out, size_t length);
+    const char* take(size_t length); // the next bytes in place, valid while the reader lives
+    template <typename T> T read() {
+        T value;
+        readBytes(&value, sizeof(T));
+        return value;
+    }
+    template <typename T> void readArray(std::vector<T>& values) {
+        uint64_t count = read<uint64_t>();
+        require(count, sizeof(T));
+        values.resize(count);
+        readBytes(values.data(), count * sizeof(T));
+    }
+    // An array written by writeAligned, used in place
+    template <typename T> const T* view(uint64_t& count) {
+        count = read<uint64_t>();
+        align();
+        require(count, sizeof(T));
+        const T* values = reinterpret_cast<const T*>(data + cursor);
+        cursor += count * sizeof(T);
+        return values;
+    }
+    std::string readString();
+    void align();
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,17 @@
+#include "bm25.h"
+#include <cmath>
+
+BM25Scorer::BM25Scorer(size_t documents, double avgLength, double k1, double b)
+    : documentCount(static_cast<double>(documents)),
+      averageLength(avgLength > 0 ? avgLength : 1.0), k1(k1), b(b) {}
+
+double BM25Scorer::idf(size_t documentFrequency) const {
+    double df = static_cast<double>(documentFrequency);
+    return std::log(1.0 + (documentCount - df + 0.5) / (df + 0.5));
+}
+
+double BM25Scorer::score(double idf, uint32_t frequency, uint32_t length) const {
+    double tf = static_cast<double>(frequency);
+    double norm = k1 * (1.0 - b + b * length / averageLength);
+    return idf * tf * (k1 + 1.0) / (tf + norm);
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#ifndef BM25_H
+#define BM25_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Okapi BM25 over the current collection statistics. Term frequency is
+// saturated by k1 and normalised by document length through b, so long notes
+// no longer win just by repeating a word.
+class BM25Scorer {
+private:
+    double documentCount;
+    double averageLength;
+    double k1;
+    double b;
+    
+public:
+    BM25Scorer(size_t documents, double avgLength, double k1 = 1.2, double b = 0.75);
+    
+    double idf(size_t documentFrequency) const;
+    double score(double idf, uint32_t frequency, uint32_t length) const;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "compressedtext.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "binaryio.h"
+#include "utils.h"
+
+const size_t CompressedText::BLOCK_SIZE;
+
+namespace {
+
+// A sequence is a token byte (literal count in the high 4 bits, match length
+// less MIN_MATCH in the low 4), the rest of a count that did not fit in 255s
+// and a last smaller byte, the literals, then a 2-byte offset back into the
+// block and the rest of the match length. The last sequence of a block is
+// literals only.
+const size_t MIN_MATCH = 4;
+const size_t HASH_BITS = 12;
+const size_t NIBBLE_MAX = 15;
+
+static_assert(CompressedText::BLOCK_SIZE <= 65536, "match offsets are 2 bytes");
+
+uint32_t load32(const char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+size_t hashOf(uint32_t word) {
+    return (word * 2654435761u) >> (32 - HASH_BITS);
+}
+
+void putLength(std::string& out, size_t length) {
+    while (length >= 255) {
+        out += static_cast<char>(255);
+        length -= 255;
+    }
+    out += static_cast<char>(length);
+}
+
+void putSequence(std::string& out, const char* literals, size_t literalCount, size_t offset, size_t matchLength) {
+    size_t matchCode = matchLength > 0 ? matchLength - MIN_MATCH : 0;
+    out += static_cast<char>((std::min(literalCount, NIBBLE_MAX) << 4) | std::min(matchCode, NIBBLE_MAX));
+    if (literalCount >= NIBBLE_MAX) {
+        putLength(out, literalCount - NIBBLE_MAX);
+    }
+    out.append(literals, literalCount);
+    if (matchLength == 0) {
+        return;
+    }
+    out += static_cast<char>(offset & 0xff);
+    out += static_cast<char>(offset >> 8);
+    if (matchCode >= NIBBLE_MAX) {
+        putLength(out, matchCode - NIBBLE_MAX);
+    }
+}
+
+void compressBlock(const char* in, size_t length, std::string& out) {
+    // Greedy: each position is looked up by its next 4 bytes and the newest
+    // earlier position with the same hash is taken if they really match
+    int32_t table[1 << HASH_BITS];
+    std::fill(table, table + (1 << HASH_BITS), -1);
+    size_t anchor = 0;
+    size_t i = 0;
+    while (i + MIN_MATCH <= length) {
+        uint32_t word = load32(in + i);
+        size_t slot = hashOf(word);
+        int32_t candidate = table[slot];
+        table[slot] = static_cast<int32_t>(i);
+        if (candidate < 0 || load32(in + candidate) != word) {
+            ++i;
+            continue;
+        }
+        size_t matchLength = MIN_MATCH;
+        while (i + matchLength < length && in[candidate + matchLength] == in[i + matchLength]) {
+            ++matchLength;
+        }
+        putSequence(out, in + anchor, i - anchor, i - candidate, matchLength);
+        i += matchLength;
+        anchor = i;
+    }
+    if (anchor < length) {
+        putSequence(out, in + anchor, length - anchor, 0, 0);
+    }
+}
+
+void corrupt() {
+    throw std::runtime_error("Stored document text is corrupt");
+}
+
+size_t getLength(const uint8_t*& in, const uint8_t* end, size_t length) {
+    if (length < NIBBLE_MAX) {
+        return length;
+    }
+    uint8_t byte;
+    do {
+        if (in == end) {
+            corrupt();
+        }
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return length;
+}
+
+void decompressInto(const char* data, size_t size, char* out, size_t length) {
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(data);
+    const uint8_t* end = in + size;
+    size_t produced = 0;
+    while (in < end) {
+        uint8_t token = *in++;
+        size_t literals = getLength(in, end, token >> 4);
+        if (literals > static_cast<size_t>(end - in) || literals > length - produced) {
+            corrupt();
+        }
+        std::memcpy(out + produced, in, literals);
+        in += literals;
+        produced += literals;
+        if (in == end) {
+            break;
+        }
+
+        if (end - in < 2) {
+            corrupt();
+        }
+        size_t offset = in[0] | (static_cast<size_t>(in[1]) << 8);
+        in += 2;
+        size_t matchLength = getLength(in, end, token & NIBBLE_MAX) + MIN_MATCH;
+        if (offset == 0 || offset > produced || matchLength > length - produced) {
+            corrupt();
+        }
+        // Byte by byte, since a match may overlap the bytes it produces
+        for (size_t k = 0; k < matchLength; ++k) {
+            out[produced + k] = out[produced + k - offset];
+        }
+        produced += matchLength;
+    }
+    if (produced != length) {
+        corrupt();
+    }
+}
+
+} // namespace
+
+std::shared_ptr<const CompressedText> CompressedText::compress(const std::string& text) {
+    auto compressed = std::make_shared<CompressedText>();
+    compressed->rawSize = text.size();
+    std::string block;
+    for (size_t start = 0; start < text.size(); start += BLOCK_SIZE) {
+        size_t length = std::min(BLOCK_SIZE, text.size() - start);
+        block.clear();
+        compressBlock(text.data() + start, length, block);
+        if (block.size() < length) {
+            compressed->data += block;
+        } else {
+            compressed->data.append(text, start, length);
+        }
+        compressed->ends.push_back(static_cast<uint32_t>(compressed->data.size()));
+    }
+    compressed->data.shrink_to_fit();
+    return compressed;
+}
+
+void CompressedText::decompressBlock(size_t block, char* out) const {
+    size_t begin = block == 0 ? 0 : blockEnds()[block - 1];
+    size_t stored = blockEnds()[block] - begin;
+    size_t length = std::min<uint64_t>(BLOCK_SIZE, rawSize - block * BLOCK_SIZE);
+    if (stored == length) {
+        std::memcpy(out, bytes() + begin, length);
+    } else {
+        decompressInto(bytes() + begin, stored, out, length);
+    }
+}
+
+std::string CompressedText::range(size_t offset, size_t length) const {
+    std::string text;
+    if (offset >= rawSize) {
+        return text;
+    }
+    length = std::min<uint64_t>(length, rawSize - offset);
+    text.reserve(length);
+    std::vector<char> buffer(BLOCK_SIZE);
+    for (size_t block = offset / BLOCK_SIZE; text.size() < length; ++block) {
+        decompressBlock(block, buffer.data());
+        size_t from = block * BLOCK_SIZE;
+        size_t skip = offset > from ? offset - from : 0;
+        size_t take = std::min(BLOCK_SIZE - skip, length - text.size());
+        text.append(buffer.data() + skip, take);
+    }
+    return text;
+}
+
+size_t CompressedText::byteSize() const {
+    return sizeof(CompressedText) + ends.capacity() * sizeof(uint32_t) + Utils::heapBytes(data);
+}
+
+void CompressedText::write(BinaryWriter& out) const {
+    out.write(rawSize);
+    out.writeAligned(blockEnds(), blockCount());
+    out.writeAligned(bytes(), byteCount());
+}
+
+std::shared_ptr<const CompressedText> CompressedText::map(BinaryReader& in) {
+    auto text = std::make_shared<CompressedText>();
+    uint64_t byteTotal;
+    text->rawSize = in.read<uint64_t>();
+    text->mappedEnds = in.view<uint32_t>(text->mappedBlockCount);
+    text->mappedData = in.view<char>(byteTotal);
+    text->file = in.mapping();
+
+    // Every block must fit in its share of the text, so a damaged file
+    // cannot send decompression out of bounds
+    if (text->mappedBlockCount != text->rawSize / BLOCK_SIZE + (text->rawSize % BLOCK_SIZE != 0 ? 1 : 0)) {
+        throw std::runtime_error("Index file is corrupt");
+    }
+    uint64_t previous = 0;
+    for (uint64_t block = 0; block < text->mappedBlockCount; ++block) {
+        uint64_t length = std::min<uint64_t>(BLOCK_SIZE, text->rawSize - block * BLOCK_SIZE);
+        uint64_t end = text->mappedEnds[block];
+        if (end <= previous || end - previous > length) {
+            throw std::runtime_error("Index file is corrupt");
+        }
+        previous = end;
+    }
+    if (previous != byteTotal) {
+        throw std::runtime_error("Index file is corrupt");
+    }
+    return text;
+}
@@ -0,0 +1,61 @@
+#ifndef COMPRESSEDTEXT_H
+#define COMPRESSEDTEXT_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+class BinaryWriter;
+class BinaryReader;
+class MappedFile;
+
+// A kept document, split into blocks of BLOCK_SIZE bytes that are each
+// compressed on their own with a small LZ77 codec (LZ4-style sequences of
+// literals and back references within the block). The end of every block
+// is recorded, so range() decompresses only the blocks it covers: a snippet
+// costs a block or two however long the document is. A block that would
+// not shrink is stored as is.
+//
+// Immutable once built, so both copies of the index share one. Text read
+// from a mapped index file stays compressed where it lies in the file.
+class CompressedText {
+public:
+    static const size_t BLOCK_SIZE = 16 * 1024;
+
+private:
+    uint64_t rawSize;
+    std::vector<uint32_t> ends; // compressed end of each block in data
+    std::string data;
+    uint64_t mappedBlockCount;
+    const uint32_t* mappedEnds; // null unless the text was mapped
+    const char* mappedData;
+    std::shared_ptr<const MappedFile> file;
+
+    bool isMapped() const { return mappedEnds != nullptr; }
+    const uint32_t* blockEnds() const { return isMapped() ? mappedEnds : ends.data(); }
+    size_t blockCount() const { return isMapped() ? mappedBlockCount : ends.size(); }
+    const char* bytes() const { return isMapped() ? mappedData : data.data(); }
+    size_t byteCount() const { return blockCount() == 0 ? 0 : blockEnds()[blockCount() - 1]; }
+    void decompressBlock(size_t block, char* out) const;
+
+public:
+    CompressedText() : rawSize(0), mappedBlockCount(0), mappedEnds(nullptr), mappedData(nullptr) {}
+
+    static std::shared_ptr<const CompressedText> compress(const std::string& text);
+
+    size_t size() const { return rawSize; }
+    bool empty() const { return rawSize == 0; }
+    // Up to length bytes from offset; throws std::runtime_error if a block is corrupt
+    std::string range(size_t offset, size_t length) const;
+    std::string text() const { return range(0, rawSize); }
+    size_t byteSize() const; // heap held; mapped text only counts the object
+
+    // The compressed blocks as is; map() uses them in place and keeps the
+    // reader's file alive for as long as the text is
+    void write(BinaryWriter& out) const;
+    static std::shared_ptr<const CompressedText> map(BinaryReader& in);
+};
+
+#endif
@@ -1,29 +1,553 @@
 #include "datapersistence.h"
 #include <fstream>
 #include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <functional>
+#include <unordered_set>
+#include "binaryio.h"
+
+const uint32_t DataPersistence::FORMAT_VERSION;
+const size_t DataPersistence::TERM_PARTITION;
+
+namespace {
+
+const char MANIFEST_MAGIC[8] = {'S', 'S', 'E', 'I', 'N', 'D', 'E', 'X'};
+const char PART_MAGIC[8] = {'S', 'S', 'E', 'I', 'P', 'A', 'R', 'T'};
+const uint32_t ORDER_MARK = 0x01020304;
+
+// Strings are saved as an array of lengths followed by all their bytes
+void writeStrings(BinaryWriter& out, const std::vector<const std::string*>& strings) {
+    std::vector<uint32_t> lengths;
+    uint64_t total = 0;
+    for (const std::string* str : strings) {
+        lengths.push_back(static_cast<uint32_t>(str->size()));
+        total += str->size();
+    }
+    out.writeArray(lengths);
+    out.write(total);
+    for (const std::string* str : strings) {
+        out.writeBytes(str->data(), str->size());
+    }
+}
+
+void readStrings(BinaryReader& in, std::vector<std::string>& strings) {
+    std::vector<uint32_t> lengths;
+    in.readArray(lengths);
+    uint64_t total = in.read<uint64_t>();
+    const char* bytes = in.take(total);
+    strings.resize(lengths.size());
+    for (size_t i = 0; i < lengths.size(); ++i) {
+        if (lengths[i] > total) {
+            throw std::runtime_error("Index file is corrupt");
+        }
+        strings[i].assign(bytes, lengths[i]);
+        bytes += lengths[i];
+        total -= lengths[i];
+    }
+}
+
+// Per-item arrays of one kind are saved as their sizes and then one
+// aligned block, which loading slices in place
+template <typename T>
+void writeNested(BinaryWriter& out, const std::vector<std::pair<const T*, const T*>>& items) {
+    std::vector<uint32_t> sizes;
+    uint64_t total = 0;
+    for (const auto& item : items) {
+        sizes.push_back(static_cast<uint32_t>(item.second - item.first));
+        total += sizes.back();
+    }
+    out.writeArray(sizes);
+    out.write(total);
+    out.align();
+    for (const auto& item : items) {
+        out.writeBytes(item.first, (item.second - item.first) * sizeof(T));
+    }
+}
+
+template <typename T>
+void viewNested(BinaryReader& in, std::vector<std::pair<const T*, const T*>>& items) {
+    std::vector<uint32_t> sizes;
+    in.readArray(sizes);
+    uint64_t total;
+    const T* next = in.view<T>(total);
+    items.resize(sizes.size());
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        if (sizes[i] > total) {
+            throw std::runtime_error("Index file is corrupt");
+        }
+        items[i] = std::make_pair(next, next + sizes[i]);
+        next += sizes[i];
+        total -= sizes[i];
+    }
+}
+
+// Every file has the same frame: magic, version and byte-order mark, the
+// body, then a checksum of all of it
+void writeFile(const std::string& path, const char (&magic)[8], const std::function<void(BinaryWriter&)>& body) {
+    BinaryWriter out(path);
+    out.writeBytes(magic, sizeof(magic));
+    out.write(DataPersistence::FORMAT_VERSION);
+    out.write(ORDER_MARK);
+    body(out);
+    uint64_t checksum = out.checksum();
+    out.write(checksum);
+    out.close();
+}
+
+void openFile(BinaryReader& in, const char (&magic)[8]) {
+    const size_t header = sizeof(magic) + 2 * sizeof(uint32_t);
+    if (in.size() < header + sizeof(uint64_t) || std::memcmp(in.bytes(), magic, sizeof(magic)) != 0) {
+        throw std::runtime_error("not a saved index");
+    }
+    in.take(sizeof(magic));
+    uint32_t version = in.read<uint32_t>();
+    if (version != DataPersistence::FORMAT_VERSION) {
+        throw std::runtime_error("unsupported format version " + std::to_string(version));
+    }
+    if (in.read<uint32_t>() != ORDER_MARK) {
+        throw std::runtime_error("saved with a different byte order");
+    }
+
+    uint64_t checksum;
+    std::memcpy(&checksum, in.bytes() + in.size() - sizeof(checksum), sizeof(checksum));
+    if (BinaryWriter::hashBytes(BinaryWriter::HASH_SEED, in.bytes(), in.size() - sizeof(checksum)) != checksum) {
+        throw std::runtime_error("checksum mismatch");
+    }
+}
+
+void closeFile(const BinaryReader& in) {
+    if (in.position() != in.size() - sizeof(uint64_t)) {
+        throw std::runtime_error("Index file is corrupt");
+    }
+}
+
+void writeTerms(BinaryWriter& out, const TermDictionary& dictionary, TermId first, TermId end) {
+    // Terms in TermId order; the trie is rebuilt from them
+    std::vector<const std::string*> terms;
+    for (TermId id = first; id < end; ++id) {
+        terms.push_back(&dictionary.getTerm(id));
+    }
+    writeStrings(out, terms);
+}
+
+void writeDocuments(BinaryWriter& out, const IndexState& state, DocId first, DocId end) {
+    // Documents in DocId order, removed ones included so ids stay put
+    const DocumentTable& documents = state.documents;
+    std::vector<const std::string*> filenames;
+    std::vector<uint8_t> live;
+    std::vector<uint32_t> lengths;
+    std::vector<PositionIndex::Range> positions;
+    std::vector<uint8_t> kept;
+    std::vector<const CompressedText*> contents;
+    for (DocId doc = first; doc < end; ++doc) {
+        filenames.push_back(&documents.getFilename(doc));
+        live.push_back(documents.isLive(doc) ? 1 : 0);
+        lengths.push_back(documents.getLength(doc));
+        positions.push_back(state.positions.getDocument(doc));
+        bool stored = state.keywordIndex.hasFileContent(doc);
+        kept.push_back(stored ? 1 : 0);
+        if (stored) {
+            contents.push_back(&state.keywordIndex.getFileContent(doc));
+        }
+    }
+    writeStrings(out, filenames);
+    out.writeArray(live);
+    out.writeArray(lengths);
+    writeNested(out, positions);
+    out.writeArray(kept);
+    for (const CompressedText* text : contents) {
+        text->write(out); // still compressed, and read back in place
+    }
+
+    const auto& streams = state.sentenceStreams();
+    std::vector<DocId> streamed;
+    for (DocId doc = first; doc < end; ++doc) {
+        if (streams.count(doc) > 0) {
+            streamed.push_back(doc);
+        }
+    }
+    out.writeArray(streamed);
+    for (DocId doc : streamed) {
+        const IndexState::SentenceStream& stream = streams.at(doc);
+        out.writeArray(stream.numbers ? *stream.numbers : std::vector<uint32_t>());
+        out.writeArray(stream.terms);
+    }
+}
+
+void writeEdges(BinaryWriter& out, const Graph& graph, TermId first, TermId end) {
+    std::vector<std::pair<const Edge*, const Edge*>> edges;
+    for (TermId topic = first; topic < end; ++topic) {
+        Graph::EdgeList list = graph.getEdges(topic);
+        edges.push_back(std::make_pair(list.begin(), list.end()));
+    }
+    writeNested(out, edges);
+}
+
+void writeSegment(BinaryWriter& out, const IndexState::SegmentView& view) {
+    // A segment as its non-empty lists, walked from its own terms rather
+    // than the whole dictionary
+    out.write(view.firstDoc);
+    out.write(view.endDoc);
+    out.write<uint64_t>(view.documentCount);
+    std::vector<TermId> ids = view.postings->termIds();
+    out.writeArray(ids);
+    for (TermId id : ids) {
+        view.postings->getPostings(id)->write(out);
+    }
+}
+
+void readTerms(BinaryReader& in, IndexState::Image& image, size_t count) {
+    std::vector<std::string> terms;
+    readStrings(in, terms);
+    if (terms.size() != count) {
+        throw std::runtime_error("Index file is corrupt");
+    }
+    for (auto& term : terms) {
+        image.terms.push_back(std::move(term));
+    }
+}
+
+void readDocuments(BinaryReader& in, IndexState::Image& image, DocId first, DocId end) {
+    size_t count = end - first;
+    std::vector<std::string> filenames;
+    std::vector<uint8_t> live;
+    std::vector<uint32_t> lengths;
+    std::vector<PositionIndex::Range> positions;
+    std::vector<uint8_t> kept;
+    readStrings(in, filenames);
+    in.readArray(live);
+    in.readArray(lengths);
+    viewNested(in, positions);
+    in.readArray(kept);
+    if (filenames.size() != count || live.size() != count || lengths.size() != count ||
+        positions.size() != count || kept.size() != count) {
+        throw std::runtime_error("Index file is corrupt");
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        image.filenames.push_back(std::move(filenames[i]));
+        image.live.push_back(live[i] != 0);
+        image.lengths.push_back(lengths[i]);
+        image.positions.push_back(positions[i]);
+        image.contents.push_back(kept[i] ? CompressedText::map(in) : nullptr);
+    }
+
+    std::vector<DocId> streamed;
+    in.readArray(streamed);
+    for (DocId doc : streamed) {
+        if (doc < first || doc >= end) {
+            throw std::runtime_error("Index file is corrupt");
+        }
+        std::vector<uint32_t> numbers;
+        IndexState::SentenceStream& stream = image.sentences[doc];
+        in.readArray(numbers);
+        in.readArray(stream.terms);
+        stream.numbers = std::make_shared<const std::vector<uint32_t>>(std::move(numbers));
+    }
+}
+
+void readEdges(BinaryReader& in, IndexState::Image& image, size_t count) {
+    std::vector<std::pair<const Edge*, const Edge*>> edges;
+    viewNested(in, edges);
+    if (edges.size() != count) {
+        throw std::runtime_error("Index file is corrupt");
+    }
+    for (const auto& list : edges) {
+        image.adjacency.push_back(Graph::EdgeList(list.first, list.second));
+    }
+}
+
+std::shared_ptr<const Segment> readSegment(BinaryReader& in, size_t termCount, size_t documentCount) {
+    DocId first = in.read<DocId>();
+    DocId end = in.read<DocId>();
+    uint64_t documents = in.read<uint64_t>();
+    if (first >= end || end > documentCount || documents > end - first) {
+        throw std::runtime_error("Index file is corrupt");
+    }
+    std::vector<TermId> ids;
+    in.readArray(ids);
+    std::vector<PostingList> postings(ids.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (ids[i] >= termCount || (i > 0 && ids[i] <= ids[i - 1])) {
+            throw std::runtime_error("Index file is corrupt");
+        }
+        postings[i].map(in);
+    }
+    return std::make_shared<Segment>(first, end, std::move(ids), std::move(postings), documents, in.mapping());
+}
+
+size_t partitions(size_t count, size_t size) {
+    return (count + size - 1) / size;
+}
+
+} // namespace
 
 DataPersistence::DataPersistence(const std::string& filename) : dataFile(filename) {}
 
-void DataPersistence::saveData(const Trie& trie, const Graph& graph, const HashMap& hashmap) {
-    std::ofstream file(dataFile);
-    if (file.is_open()) {
-        file << "Search Engine Data - Format: v1.0" << std::endl;
-        file << "Data structures serialized here..." << std::endl;
-        file.close();
-        std::cout << "Data saved successfully to " << dataFile << std::endl;
-    } else {
-        std::cout << "Warning: Could not save data to " << dataFile << std::endl;
+std::string DataPersistence::partName(uint64_t part) const {
+    return dataFile + "." + std::to_string(part);
+}
+
+bool DataPersistence::saveData(const IndexState& state, const DirectorySync& sync, uint64_t epoch) {
+    // Without a manifest of its own, the one on disk is only read for the
+    // part numbers to avoid and the parts to delete afterwards
+    Manifest previous = saved;
+    if (!previous.valid && std::ifstream(dataFile).is_open()) {
+        try {
+            BinaryReader in(dataFile);
+            openFile(in, MANIFEST_MAGIC);
+            in.read<uint64_t>(); // log sequence
+            previous.termCount = in.read<uint64_t>();
+            in.read<uint64_t>(); // documents
+            in.read<uint64_t>(); // topics
+            previous.nextPart = in.read<uint64_t>();
+            in.readArray(previous.termParts);
+            in.readArray(previous.documentParts);
+            in.readArray(previous.graphParts);
+            in.readArray(previous.segmentParts);
+            in.readArray(previous.garbage);
+        } catch (const std::exception&) {
+            previous = Manifest(); // unreadable: whatever it lists cannot be loaded anyway
+        }
     }
+
+    Manifest next;
+    next.valid = true;
+    next.epoch = epoch;
+    next.termCount = state.termDictionary.size();
+    next.nextPart = previous.nextPart;
+    std::vector<uint64_t> written;
+    size_t reused = 0;
+    std::string temporary = dataFile + ".tmp";
+
+    try {
+        auto writePart = [&](const std::function<void(BinaryWriter&)>& body) {
+            uint64_t part = next.nextPart++;
+            written.push_back(part);
+            writeFile(partName(part), PART_MAGIC, body);
+            return part;
+        };
+
+        // Terms only ever grow, so a range that was full is still the same
+        size_t termCount = next.termCount;
+        for (size_t p = 0; p < partitions(termCount, TERM_PARTITION); ++p) {
+            TermId first = static_cast<TermId>(p * TERM_PARTITION);
+            TermId end = static_cast<TermId>(std::min(termCount, (p + 1) * TERM_PARTITION));
+            if (saved.valid && p < saved.termParts.size() && end <= saved.termCount) {
+                next.termParts.push_back(saved.termParts[p]);
+                ++reused;
+            } else {
+                next.termParts.push_back(writePart([&](BinaryWriter& out) {
+                    writeTerms(out, state.termDictionary, first, end);
+                }));
+            }
+        }
+
+        size_t documentCount = state.documents.size();
+        for (size_t p = 0; p < partitions(documentCount, IndexState::DOCUMENT_PARTITION); ++p) {
+            DocId first = static_cast<DocId>(p * IndexState::DOCUMENT_PARTITION);
+            DocId end = static_cast<DocId>(std::min(documentCount, (p + 1) * IndexState::DOCUMENT_PARTITION));
+            if (saved.valid && p < saved.documentParts.size() && state.documentsChanged(p) <= saved.epoch) {
+                next.documentParts.push_back(saved.documentParts[p]);
+                ++reused;
+            } else {
+                next.documentParts.push_back(writePart([&](BinaryWriter& out) {
+                    writeDocuments(out, state, first, end);
+                }));
+            }
+        }
+
+        size_t topicCount = state.topicGraph.topicCount();
+        for (size_t p = 0; p < partitions(topicCount, Graph::PARTITION_TOPICS); ++p) {
+            TermId first = static_cast<TermId>(p * Graph::PARTITION_TOPICS);
+            TermId end = static_cast<TermId>(std::min(topicCount, (p + 1) * Graph::PARTITION_TOPICS));
+            if (saved.valid && p < saved.graphParts.size() && state.topicGraph.partitionChanged(p) <= saved.epoch) {
+                next.graphParts.push_back(saved.graphParts[p]);
+                ++reused;
+            } else {
+                next.graphParts.push_back(writePart([&](BinaryWriter& out) {
+                    writeEdges(out, state.topicGraph, first, end);
+                }));
+            }
+        }
+
+        // Frozen segments are recognised by identity; the mutable one is
+        // always written and comes back frozen
+        std::vector<IndexState::SegmentView> views = state.segmentViews();
+        const auto& frozen = state.frozenSegments();
+        for (size_t i = 0; i < views.size(); ++i) {
+            if (views[i].firstDoc >= views[i].endDoc) {
+                continue;
+            }
+            std::shared_ptr<const Segment> segment = i < frozen.size() ? frozen[i] : nullptr;
+            uint64_t part = 0;
+            bool found = false;
+            for (size_t j = 0; segment && saved.valid && j < saved.segments.size() && !found; ++j) {
+                if (saved.segments[j].lock() == segment) {
+                    part = saved.segmentParts[j];
+                    found = true;
+                }
+            }
+            if (found) {
+                ++reused;
+            } else {
+                const IndexState::SegmentView& view = views[i];
+                part = writePart([&](BinaryWriter& out) {
+                    writeSegment(out, view);
+                });
+            }
+            next.segmentParts.push_back(part);
+            next.segments.push_back(segment);
+        }
+
+        // Parts the last manifest listed but this one does not
+        std::unordered_set<uint64_t> listed;
+        for (const auto* parts : {&next.termParts, &next.documentParts, &next.graphParts, &next.segmentParts}) {
+            listed.insert(parts->begin(), parts->end());
+        }
+        for (const auto* parts : {&previous.termParts, &previous.documentParts, &previous.graphParts,
+                                  &previous.segmentParts}) {
+            for (uint64_t part : *parts) {
+                if (listed.count(part) == 0) {
+                    next.garbage.push_back(part);
+                }
+            }
+        }
+
+        writeFile(temporary, MANIFEST_MAGIC, [&](BinaryWriter& out) {
+            out.write(state.loggedThrough()); // uploads logged after this are replayed on load
+            out.write<uint64_t>(termCount);
+            out.write<uint64_t>(documentCount);
+            out.write<uint64_t>(topicCount);
+            out.write(next.nextPart);
+            out.writeArray(next.termParts);
+            out.writeArray(next.documentParts);
+            out.writeArray(next.graphParts);
+            out.writeArray(next.segmentParts);
+            out.writeArray(next.garbage);
+
+            const auto& files = sync.indexedFiles();
+            out.write<uint64_t>(files.size());
+            for (const auto& file : files) {
+                out.writeString(file.first);
+                out.write(file.second);
+            }
+        });
+
+        // rename() does not replace an existing file everywhere
+        if (std::rename(temporary.c_str(), dataFile.c_str()) != 0 &&
+            (std::remove(dataFile.c_str()) != 0 || std::rename(temporary.c_str(), dataFile.c_str()) != 0)) {
+            throw std::runtime_error("Cannot replace " + dataFile);
+        }
+    } catch (const std::exception& e) {
+        std::remove(temporary.c_str());
+        for (uint64_t part : written) {
+            std::remove(partName(part).c_str());
+        }
+        std::cout << "Warning: Could not save data to " << dataFile << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    // Parts dropped last time are tried again in case a crash cut that short
+    for (const auto* parts : {&previous.garbage, &next.garbage}) {
+        for (uint64_t part : *parts) {
+            std::remove(partName(part).c_str());
+        }
+    }
+    saved = next;
+    std::cout << "Data saved successfully to " << dataFile << " (" << written.size() << " parts written, "
+              << reused << " unchanged)" << std::endl;
+    return true;
 }
 
-bool DataPersistence::loadData(Trie& trie, Graph& graph, HashMap& hashmap) { // FIXED: removed const
-    std::ifstream file(dataFile);
-    if (file.is_open()) {
-        std::string line;
-        std::getline(file, line);
-        file.close();
-        std::cout << "Data loaded successfully from " << dataFile << std::endl;
-        return true;
+DataPersistence::LoadResult DataPersistence::loadData(IndexState::Image& image, DirectorySync& sync) {
+    if (!std::ifstream(dataFile).is_open()) {
+        return NOT_FOUND;
+    }
+
+    try {
+        // Parsed into fresh objects first, so a failure leaves nothing half loaded
+        IndexState::Image loaded;
+        DirectorySync files;
+        Manifest manifest;
+        BinaryReader in(dataFile);
+        openFile(in, MANIFEST_MAGIC);
+        loaded.logSequence = in.read<uint64_t>();
+        manifest.termCount = in.read<uint64_t>();
+        uint64_t documentCount = in.read<uint64_t>();
+        uint64_t topicCount = in.read<uint64_t>();
+        manifest.nextPart = in.read<uint64_t>();
+        in.readArray(manifest.termParts);
+        in.readArray(manifest.documentParts);
+        in.readArray(manifest.graphParts);
+        in.readArray(manifest.segmentParts);
+        in.readArray(manifest.garbage);
+        uint64_t fileCount = in.read<uint64_t>();
+        for (uint64_t i = 0; i < fileCount; ++i) {
+            std::string filename = in.readString();
+            files.restore(filename, in.read<FileRecord>());
+        }
+        closeFile(in);
+        if (manifest.termParts.size() != partitions(manifest.termCount, TERM_PARTITION) ||
+            manifest.documentParts.size() != partitions(documentCount, IndexState::DOCUMENT_PARTITION) ||
+            manifest.graphParts.size() != partitions(topicCount, Graph::PARTITION_TOPICS)) {
+            throw std::runtime_error("Index file is corrupt");
+        }
+
+        // Each part is read through a reader of its own; documents, edges
+        // and segments keep their file mapped
+        auto readPart = [&](uint64_t part, bool keep, const std::function<void(BinaryReader&)>& body) {
+            BinaryReader reader(partName(part));
+            openFile(reader, PART_MAGIC);
+            body(reader);
+            closeFile(reader);
+            if (keep) {
+                loaded.files.push_back(reader.mapping());
+            }
+        };
+        for (size_t p = 0; p < manifest.termParts.size(); ++p) {
+            size_t count = std::min<uint64_t>(manifest.termCount - p * TERM_PARTITION, TERM_PARTITION);
+            readPart(manifest.termParts[p], false, [&](BinaryReader& part) {
+                readTerms(part, loaded, count);
+            });
+        }
+        for (size_t p = 0; p < manifest.documentParts.size(); ++p) {
+            DocId first = static_cast<DocId>(p * IndexState::DOCUMENT_PARTITION);
+            DocId end = static_cast<DocId>(std::min<uint64_t>(documentCount, first + IndexState::DOCUMENT_PARTITION));
+            readPart(manifest.documentParts[p], true, [&](BinaryReader& part) {
+                readDocuments(part, loaded, first, end);
+            });
+        }
+        for (size_t p = 0; p < manifest.graphParts.size(); ++p) {
+            size_t count = std::min<uint64_t>(topicCount - p * Graph::PARTITION_TOPICS, Graph::PARTITION_TOPICS);
+            readPart(manifest.graphParts[p], true, [&](BinaryReader& part) {
+                readEdges(part, loaded, count);
+            });
+        }
+        for (uint64_t segmentPart : manifest.segmentParts) {
+            readPart(segmentPart, true, [&](BinaryReader& part) {
+                loaded.segments.push_back(readSegment(part, manifest.termCount, documentCount));
+            });
+        }
+        for (size_t i = 1; i < loaded.segments.size(); ++i) {
+            if (loaded.segments[i]->firstDoc() < loaded.segments[i - 1]->endDoc()) {
+                throw std::runtime_error("Index file is corrupt");
+            }
+        }
+        manifest.segments.assign(loaded.segments.begin(), loaded.segments.end());
+        manifest.valid = true;
+
+        std::swap(image, loaded);
+        for (const auto& file : files.indexedFiles()) {
+            sync.restore(file.first, file.second);
+        }
+        saved = manifest; // the restored index starts at epoch 1, so nothing is newer yet
+    } catch (const std::exception& e) {
+        std::cout << "Warning: Could not load " << dataFile << ": " << e.what() << std::endl;
+        return FAILED;
     }
-    return false;
+    std::cout << "Data loaded successfully from " << dataFile << std::endl;
+    return LOADED;
 }
\ No newline at end of file
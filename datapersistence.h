@@ -1,19 +1,67 @@
 #ifndef DATAPERSISTENCE_H
 #define DATAPERSISTENCE_H
 
-#include "trie.h"
-#include "graph.h"
-#include "hashmap.h"
 #include <string>
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include "indexstate.h"
+#include "directorysync.h"
 
+// Saves the index as a manifest and numbered part files next to it: terms,
+// documents and topic edges in fixed ranges of ids, and one file per index
+// segment. A checkpoint writes only the parts changed since the last one
+// (term ranges that grew, document and graph ranges changed in a later
+// epoch, segments not saved yet) plus a new manifest listing the rest as
+// they are, so its cost follows the size of the change rather than of the
+// index. Segments never change once frozen, so a saved one is reused until
+// a merge replaces it.
+//
+// Every file starts with a magic string, the format version and a
+// byte-order mark and ends with a checksum of everything before it; the
+// manifest also records the last upload log sequence the save includes.
+// Arrays are stored as raw blocks on 8-byte boundaries, and loading maps
+// the parts: postings, positions and kept text, still compressed, are used
+// where they lie, and only the parts uploads change are copied out. Parts go to new numbers and the
+// manifest to a temporary file renamed over the old one, so a crash while
+// saving leaves the previous index intact; parts the new manifest no
+// longer lists are deleted once it is in place.
 class DataPersistence {
 private:
+    // What the manifest on disk lists, kept so the next checkpoint can
+    // tell which parts it may reuse
+    struct Manifest {
+        bool valid;      // this process saved or loaded it
+        uint64_t epoch;  // document and graph parts changed later are not in it
+        uint64_t termCount;
+        std::vector<uint64_t> termParts;     // by TERM_PARTITION terms
+        std::vector<uint64_t> documentParts; // by IndexState::DOCUMENT_PARTITION documents
+        std::vector<uint64_t> graphParts;    // by Graph::PARTITION_TOPICS topics
+        std::vector<uint64_t> segmentParts;
+        std::vector<std::weak_ptr<const Segment>> segments; // what each segment part holds
+        std::vector<uint64_t> garbage; // parts no longer listed, deleted after the manifest
+        uint64_t nextPart;
+        
+        Manifest() : valid(false), epoch(0), termCount(0), nextPart(0) {}
+    };
+    
     std::string dataFile;
+    Manifest saved;
+    
+    std::string partName(uint64_t part) const;
     
 public:
+    enum LoadResult { NOT_FOUND, LOADED, FAILED };
+    
+    static const uint32_t FORMAT_VERSION = 5;
+    static const size_t TERM_PARTITION = 1 << 14;
+    
     DataPersistence(const std::string& filename = "search_data.dat");
-    void saveData(const Trie& trie, const Graph& graph, const HashMap& hashmap);
-    bool loadData(Trie& trie, Graph& graph, HashMap& hashmap); // FIXED: removed const
+    // epoch is the one IndexState::beginCheckpoint closed before state was read
+    bool saveData(const IndexState& state, const DirectorySync& sync, uint64_t epoch);
+    // Anything but LOADED leaves image and sync untouched; FAILED means a
+    // saved index exists but could not be read
+    LoadResult loadData(IndexState::Image& image, DirectorySync& sync);
 };
 
 #endif
\ No newline at end of file
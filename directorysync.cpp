@@ -0,0 +1,154 @@
+#include "directorysync.h"
+#include <fstream>
+#include <stdexcept>
+#include <unordered_set>
+#include <algorithm>
+#include <dirent.h>
+#include <sys/stat.h>
+
+bool DirectorySync::statFile(const std::string& filename, FileRecord& record) {
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0) {
+        return false;
+    }
+    record.modified = static_cast<int64_t>(info.st_mtime);
+    record.size = static_cast<uint64_t>(info.st_size);
+    record.hash = 0;
+    return true;
+}
+
+bool DirectorySync::isIndexable(const std::string& filename) {
+    static const char* extensions[] = {".txt", ".md"};
+    for (const char* extension : extensions) {
+        std::string suffix(extension);
+        if (filename.size() > suffix.size() &&
+            filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void DirectorySync::listFiles(const std::string& directory, std::vector<std::string>& files) {
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        throw std::runtime_error("Cannot open directory: " + directory);
+    }
+    
+    std::vector<std::string> subdirectories;
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.empty() || name[0] == '.') {
+            continue; // ., .. and hidden files
+        }
+        
+        std::string path = directory + "/" + name;
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) {
+            continue;
+        }
+        if (S_ISDIR(info.st_mode)) {
+            subdirectories.push_back(path);
+        } else if (S_ISREG(info.st_mode) && isIndexable(name)) {
+            files.push_back(path);
+        }
+    }
+    closedir(dir);
+    
+    for (const auto& subdirectory : subdirectories) {
+        listFiles(subdirectory, files);
+    }
+}
+
+uint64_t DirectorySync::hashFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open file: " + filename);
+    }
+    
+    uint64_t hash = 14695981039346656037ULL;
+    char buffer[64 * 1024];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+        std::streamsize read = file.gcount();
+        for (std::streamsize i = 0; i < read; ++i) {
+            hash ^= static_cast<unsigned char>(buffer[i]);
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+DirectorySync::Changes DirectorySync::scan(const std::string& directory) {
+    std::string root = directory;
+    while (root.size() > 1 && root[root.size() - 1] == '/') {
+        root.erase(root.size() - 1);
+    }
+    
+    std::vector<std::string> files;
+    listFiles(root, files);
+    std::sort(files.begin(), files.end());
+    
+    Changes changes;
+    std::unordered_set<std::string> seen(files.begin(), files.end());
+    for (const auto& path : files) {
+        FileRecord current;
+        if (!statFile(path, current)) {
+            continue;
+        }
+        
+        // Size and mtime both unchanged: trust the file without reading it
+        auto known = records.find(path);
+        if (known != records.end() && known->second.size == current.size &&
+            known->second.modified == current.modified) {
+            ++changes.unchanged;
+            continue;
+        }
+        
+        try {
+            current.hash = hashFile(path);
+        } catch (const std::exception&) {
+            continue; // vanished or unreadable since listing; next sync retries
+        }
+        if (known != records.end() && known->second.hash == current.hash && known->second.size == current.size) {
+            known->second = current; // touched, not edited
+            ++changes.unchanged;
+            continue;
+        }
+        
+        pending[path] = current;
+        if (known == records.end()) {
+            changes.added.push_back(path);
+        } else {
+            changes.modified.push_back(path);
+        }
+    }
+    
+    std::string prefix = root + "/";
+    for (const auto& record : records) {
+        const std::string& path = record.first;
+        if (path.compare(0, prefix.size(), prefix) == 0 && seen.find(path) == seen.end()) {
+            changes.removed.push_back(path);
+        }
+    }
+    std::sort(changes.removed.begin(), changes.removed.end());
+    
+    return changes;
+}
+
+void DirectorySync::markIndexed(const std::string& filename) {
+    auto it = pending.find(filename);
+    if (it != pending.end()) {
+        records[filename] = it->second;
+        pending.erase(it);
+    }
+}
+
+void DirectorySync::markRemoved(const std::string& filename) {
+    records.erase(filename);
+    pending.erase(filename);
+}
+
+void DirectorySync::restore(const std::string& filename, const FileRecord& record) {
+    records[filename] = record;
+    pending.erase(filename);
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef DIRECTORYSYNC_H
+#define DIRECTORYSYNC_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// What the last sync saw of a file
+struct FileRecord {
+    int64_t modified; // seconds since the epoch
+    uint64_t size;
+    uint64_t hash;    // FNV-1a of the contents
+};
+
+// Remembers every file it has indexed, so a later sync of the same directory
+// reads only files whose size or mtime moved and re-indexes only those whose
+// contents really changed.
+class DirectorySync {
+public:
+    struct Changes {
+        std::vector<std::string> added;
+        std::vector<std::string> modified;
+        std::vector<std::string> removed;
+        size_t unchanged;
+        
+        Changes() : unchanged(0) {}
+    };
+    
+private:
+    std::unordered_map<std::string, FileRecord> records;
+    std::unordered_map<std::string, FileRecord> pending; // changed on disk, not indexed yet
+    
+    static void listFiles(const std::string& directory, std::vector<std::string>& files);
+    
+public:
+    Changes scan(const std::string& directory);
+    void markIndexed(const std::string& filename);
+    void markRemoved(const std::string& filename);
+    
+    // Files indexed so far, for saving with the index, and restoring one
+    const std::unordered_map<std::string, FileRecord>& indexedFiles() const { return records; }
+    void restore(const std::string& filename, const FileRecord& record);
+    
+    static uint64_t hashFile(const std::string& filename);
+    // Size and mtime of a file, hash left 0; false if it cannot be read
+    static bool statFile(const std::string& filename, FileRecord& record);
+    static bool isIndexable(const std::string& filename);
+};
+
+#endif
\ No newline at end of file
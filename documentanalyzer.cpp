@@ -0,0 +1,117 @@
+#include "documentanalyzer.h"
+#include <unordered_map>
+#include <fstream>
+#include <stdexcept>
+
+const size_t DocumentAnalyzer::STORED_CONTENT_LIMIT;
+const size_t DocumentAnalyzer::PAIR_TABLE_LIMIT;
+
+void DocumentAnalyzer::analyze(AnalyzedDocument& document, bool positional) {
+    Tokenizer tokenizer(*document.content);
+    analyze(document, tokenizer, positional);
+    // Compressed here, on the analysing thread, not under the writer lock
+    document.text = CompressedText::compress(*document.content);
+}
+
+void DocumentAnalyzer::analyzeFile(AnalyzedDocument& document, bool positional) {
+    std::ifstream file(document.filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open file: " + document.filename);
+    }
+    file.seekg(0, std::ios::end);
+    std::streamoff fileSize = file.tellg();
+    
+    if (fileSize >= 0 && static_cast<size_t>(fileSize) <= STORED_CONTENT_LIMIT) {
+        // Taken before reading, so a write racing the read moves the mtime
+        // past it and the text is never taken for the file's
+        document.fromFile = DirectorySync::statFile(document.filename, document.source);
+        document.content = std::make_shared<std::string>(Utils::readFile(document.filename));
+        analyze(document, positional);
+        return;
+    }
+    
+    // Upload memory stays at one chunk however large the file is; snippets
+    // for it are read back from disk around the hit
+    file.clear();
+    file.seekg(0, std::ios::beg);
+    Tokenizer tokenizer(file);
+    analyze(document, tokenizer, positional);
+}
+
+void DocumentAnalyzer::countPairs(const std::vector<uint32_t>& sentence,
+                                  std::unordered_map<uint64_t, size_t>& seen, std::vector<EdgeCount>& pairs) {
+    // Every two words of a sentence are related once per time they meet;
+    // the pairs are counted here, on the analysing thread, so the graph is
+    // touched once per distinct pair rather than once per meeting
+    if (seen.size() >= PAIR_TABLE_LIMIT) {
+        seen.clear();
+    }
+    for (size_t i = 0; i < sentence.size(); ++i) {
+        for (size_t j = i + 1; j < sentence.size(); ++j) {
+            uint32_t a = sentence[i];
+            uint32_t b = sentence[j];
+            if (a == b) {
+                continue;
+            }
+            uint64_t key = a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+            auto found = seen.find(key);
+            if (found != seen.end()) {
+                ++pairs[found->second].count;
+            } else {
+                seen.insert(std::make_pair(key, pairs.size()));
+                EdgeCount pair = {a, b, 1};
+                pairs.push_back(pair);
+            }
+        }
+    }
+}
+
+void DocumentAnalyzer::analyze(AnalyzedDocument& document, Tokenizer& tokenizer, bool positional) {
+    std::unordered_map<std::string, uint32_t> local;
+    std::unordered_map<uint64_t, size_t> seenPairs;
+    std::vector<uint32_t> sentence;
+    std::vector<uint32_t> sentences;
+    size_t currentSentence = 0;
+    bool streamed = !document.content;
+    
+    while (tokenizer.next()) {
+        if (tokenizer.sentence() != currentSentence) {
+            if (streamed) {
+                sentences.push_back(INVALID_TERM);
+            } else {
+                countPairs(sentence, seenPairs, document.pairs);
+                sentence.clear();
+            }
+            currentSentence = tokenizer.sentence();
+        }
+        
+        auto found = local.find(tokenizer.term());
+        uint32_t number;
+        if (found == local.end()) {
+            number = static_cast<uint32_t>(document.terms.size());
+            local.insert(std::make_pair(tokenizer.term(), number));
+            document.terms.push_back(tokenizer.term());
+            document.counts.push_back(0);
+        } else {
+            number = found->second;
+        }
+        
+        ++document.counts[number];
+        if (positional) {
+            document.occurrences.push_back(Occurrence(number, static_cast<uint32_t>(tokenizer.position()),
+                                                      static_cast<uint32_t>(tokenizer.offset())));
+        }
+        if (streamed) {
+            sentences.push_back(number);
+        } else {
+            sentence.push_back(number);
+        }
+        ++document.length;
+    }
+    if (streamed) {
+        sentences.push_back(INVALID_TERM);
+        document.sentences = std::make_shared<const std::vector<uint32_t>>(std::move(sentences));
+    } else {
+        countPairs(sentence, seenPairs, document.pairs);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef DOCUMENTANALYZER_H
+#define DOCUMENTANALYZER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include "positionindex.h"
+#include "graph.h"
+#include "compressedtext.h"
+#include "utils.h"
+#include "directorysync.h"
+
+// Everything one tokenizer pass over a document produces. Terms are numbered
+// locally, in order of first appearance, so a document can be analysed on any
+// thread without touching the shared dictionary; the engine maps the local
+// numbers to TermIds when it commits the document.
+struct AnalyzedDocument {
+    std::string filename;
+    std::shared_ptr<const std::string> content; // null if not kept
+    std::shared_ptr<const CompressedText> text; // content as kept, shared by every copy of the index
+    bool fromFile;                       // content was read from the file named, as it was when source was taken
+    FileRecord source;
+    std::string error;                   // set when the document could not be read
+    std::vector<std::string> terms;      // local number -> term
+    std::vector<uint32_t> counts;        // local number -> occurrences
+    std::vector<Occurrence> occurrences; // term holds the local number
+    std::vector<EdgeCount> pairs;        // kept text: terms sharing a sentence, as local numbers, in order of first meeting
+    // Streamed files only: local numbers, each sentence ended by INVALID_TERM;
+    // shared by every copy of the index, like content
+    std::shared_ptr<const std::vector<uint32_t>> sentences;
+    uint32_t length;
+    
+    AnalyzedDocument() : fromFile(false), length(0) {}
+};
+
+class DocumentAnalyzer {
+public:
+    // Files larger than this are tokenized straight from disk in fixed-size
+    // chunks and their text is not kept in memory; their pairs are counted
+    // at commit, a table at a time, from the sentences
+    static const size_t STORED_CONTENT_LIMIT = 16 * 1024 * 1024;
+    // Distinct pairs counted in one table; once full it starts over, so
+    // a pair may appear again further on
+    static const size_t PAIR_TABLE_LIMIT = 1 << 18;
+    
+    static void analyze(AnalyzedDocument& document, bool positional);
+    static void analyze(AnalyzedDocument& document, Tokenizer& tokenizer, bool positional);
+    static void analyzeFile(AnalyzedDocument& document, bool positional);
+    static void countPairs(const std::vector<uint32_t>& sentence, std::unordered_map<uint64_t, size_t>& seen,
+                           std::vector<EdgeCount>& pairs);
+};
+
+#endif
\ No newline at end of file
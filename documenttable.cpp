@@ -0,0 +1,105 @@
+#include "documenttable.h"
+#include <algorithm>
+#include "utils.h"
+
+DocumentTable::DocumentTable(const DocumentTable& other) {
+    *this = other;
+}
+
+DocumentTable& DocumentTable::operator=(const DocumentTable& other) {
+    if (this != &other) {
+        ids = other.ids;
+        lengths = other.lengths;
+        filenameBytes = other.filenameBytes;
+        totalLength = other.totalLength;
+        live = other.live;
+        shortestLength = other.shortestLength;
+        filenames.assign(other.filenames.size(), nullptr);
+        for (const auto& pair : ids) {
+            filenames[pair.second] = &pair.first;
+        }
+    }
+    return *this;
+}
+
+DocId DocumentTable::addDocument(const std::string& filename) {
+    auto it = ids.find(filename);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    
+    DocId id = static_cast<DocId>(filenames.size());
+    it = ids.insert(std::make_pair(filename, id)).first;
+    filenames.push_back(&it->first);
+    filenameBytes += Utils::heapBytes(it->first);
+    lengths.push_back(0);
+    ++live;
+    return id;
+}
+
+DocId DocumentTable::addRemovedDocument() {
+    filenames.push_back(nullptr);
+    lengths.push_back(0);
+    return static_cast<DocId>(filenames.size() - 1);
+}
+
+void DocumentTable::removeDocument(DocId id) {
+    if (!isLive(id)) {
+        return;
+    }
+    filenameBytes -= Utils::heapBytes(*filenames[id]);
+    ids.erase(*filenames[id]);
+    filenames[id] = nullptr;
+    totalLength -= lengths[id];
+    lengths[id] = 0;
+    --live;
+}
+
+DocId DocumentTable::find(const std::string& filename) const {
+    auto it = ids.find(filename);
+    return it != ids.end() ? it->second : INVALID_DOC;
+}
+
+const std::string& DocumentTable::getFilename(DocId id) const {
+    static const std::string removed;
+    return filenames[id] != nullptr ? *filenames[id] : removed;
+}
+
+void DocumentTable::setLength(DocId id, uint32_t length) {
+    totalLength = totalLength - lengths[id] + length;
+    lengths[id] = length;
+    if (length > 0) {
+        shortestLength = std::min(shortestLength, length);
+    }
+}
+
+double DocumentTable::averageLength() const {
+    return live == 0 ? 0.0 : static_cast<double>(totalLength) / live;
+}
+
+uint32_t DocumentTable::minimumLength() const {
+    return shortestLength == UINT32_MAX ? 0 : shortestLength;
+}
+
+size_t DocumentTable::size() const {
+    return filenames.size();
+}
+
+size_t DocumentTable::liveCount() const {
+    return live;
+}
+
+void DocumentTable::clear() {
+    ids.clear();
+    filenames.clear();
+    lengths.clear();
+    filenameBytes = 0;
+    totalLength = 0;
+    live = 0;
+    shortestLength = UINT32_MAX;
+}
+
+size_t DocumentTable::byteSize() const {
+    return ids.size() * Utils::hashEntryBytes(sizeof(std::pair<const std::string, DocId>)) + filenameBytes +
+           filenames.capacity() * sizeof(const std::string*) + lengths.capacity() * sizeof(uint32_t);
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#ifndef DOCUMENTTABLE_H
+#define DOCUMENTTABLE_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+typedef uint32_t DocId;
+
+const DocId INVALID_DOC = 0xFFFFFFFFu;
+
+// Maps filenames to dense document ids so postings only carry integers;
+// names are looked up again only for the results that are shown. Ids of
+// removed documents are never reused: a replaced file gets a fresh id, so
+// postings keep growing in DocId order.
+class DocumentTable {
+private:
+    std::unordered_map<std::string, DocId> ids;
+    std::vector<const std::string*> filenames; // points at the keys of ids; null once removed
+    std::vector<uint32_t> lengths;             // indexed terms per document
+    size_t filenameBytes;                      // heap bytes of the keys
+    uint64_t totalLength;
+    size_t live;
+    uint32_t shortestLength; // lower bound on any non-empty document's length
+
+public:
+    DocumentTable() : filenameBytes(0), totalLength(0), live(0), shortestLength(UINT32_MAX) {}
+    DocumentTable(const DocumentTable& other);
+    DocumentTable& operator=(const DocumentTable& other);
+
+    DocId addDocument(const std::string& filename);
+    DocId addRemovedDocument(); // keeps the ids of an index read back from disk in line
+    void removeDocument(DocId id);
+    bool isLive(DocId id) const { return id < filenames.size() && filenames[id] != nullptr; }
+    DocId find(const std::string& filename) const;
+    const std::string& getFilename(DocId id) const;
+    void setLength(DocId id, uint32_t length);
+    uint32_t getLength(DocId id) const { return lengths[id]; }
+    double averageLength() const;
+    uint32_t minimumLength() const;
+    size_t size() const;      // bound on DocIds, removed documents included
+    size_t liveCount() const; // documents currently indexed
+    void clear();
+    size_t byteSize() const;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,112 @@
+// Gives up kept text under a memory budget and checks that only text read
+// from a file still unchanged on disk goes: text uploaded as is, queued
+// uploads, and a file edited since it was read all keep theirs, and every
+// document still gets its snippet. Exits with 1 on a failed check;
+// everything is written to a fresh temporary directory.
+#include "searchengine.h"
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <unistd.h>
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+// Long random words barely compress, so the text is worth more than its
+// sentences and is a candidate for eviction
+std::string documentText(unsigned seed, const std::string& marker) {
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::string text;
+    for (int sentence = 0; sentence < 200; ++sentence) {
+        for (int word = 0; word < 10; ++word) {
+            for (int i = 0; i < 12; ++i) {
+                text += static_cast<char>(letter(random));
+            }
+            text += ' ';
+        }
+        text += sentence == 100 ? marker + " needle. " : "end. ";
+    }
+    return text;
+}
+
+void checkSnippets(SearchEngine& engine, const std::string& directory) {
+    check(engine.getSnippet(directory + "/kept.txt", "needle").find("kept") != std::string::npos,
+          "snippet of the evicted file");
+    check(engine.getSnippet(directory + "/edited.txt", "needle").find("original") != std::string::npos,
+          "snippet of the edited file");
+    check(engine.getSnippet("memory.txt", "needle").find("memory") != std::string::npos,
+          "snippet of the uploaded text");
+    check(engine.getSnippet("queued.txt", "needle").find("queued") != std::string::npos,
+          "snippet of the queued text");
+}
+
+void removeDirectory(const std::string& directory) {
+    if (DIR* dir = opendir(directory.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name != "." && name != "..") {
+                std::remove((directory + "/" + name).c_str());
+            }
+        }
+        closedir(dir);
+    }
+    rmdir(directory.c_str());
+}
+
+} // namespace
+
+int main() {
+    const char* temporary = std::getenv("TMPDIR");
+    std::string pattern = std::string(temporary != nullptr ? temporary : "/tmp") + "/eviction_testXXXXXX";
+    std::vector<char> path(pattern.begin(), pattern.end());
+    path.push_back('\0');
+    if (mkdtemp(path.data()) == nullptr) {
+        std::cout << "Cannot create a directory from " << pattern << "\n";
+        return 1;
+    }
+    std::string directory(path.data());
+    std::string dataFile = directory + "/search_data.dat";
+    std::string logFile = directory + "/search_data.wal";
+
+    {
+        SearchEngine engine(dataFile, logFile);
+        std::ofstream(directory + "/kept.txt", std::ios::binary) << documentText(1, "kept");
+        engine.uploadNote(directory + "/kept.txt");
+        std::ofstream(directory + "/edited.txt", std::ios::binary) << documentText(2, "original");
+        engine.uploadNote(directory + "/edited.txt");
+        std::ofstream(directory + "/edited.txt", std::ios::binary) << "rewritten since it was read.";
+        engine.uploadFile("memory.txt", documentText(3, "memory"));
+        JobId job = engine.queueUpload("queued.txt", documentText(4, "queued"));
+        UploadStatus::State state;
+        while ((state = engine.uploadStatus(job).state) == UploadStatus::QUEUED || state == UploadStatus::INDEXING) {
+            std::this_thread::yield();
+        }
+
+        size_t kept = engine.memoryUsage().contents;
+        engine.setMemoryBudget(1);
+        MemoryUsage usage = engine.memoryUsage();
+        check(usage.sentences > 0, "the unchanged file gives up its text");
+        check(usage.contents > 0 && usage.contents < kept, "the other three keep theirs");
+        checkSnippets(engine, directory);
+    }
+
+    removeDirectory(directory);
+    if (failures > 0) {
+        return 1;
+    }
+    std::cout << "Only unchanged files gave up their text\n";
+    return 0;
+}
@@ -6,34 +6,96 @@
 #include <fstream>
 #include <functional>
 
-void Graph::addEdge(const std::string& topic1, const std::string& topic2) {
+const size_t Graph::PARTITION_TOPICS;
+
+void Graph::addEdge(TermId topic1, TermId topic2) {
     if (topic1 == topic2) return;
     
-    for (auto& edge : adjacencyList[topic1]) {
-        if (edge.destination == topic2) {
-            edge.weight++;
-            return;
+    addTopic(topic1);
+    addTopic(topic2);
+    
+    // Both directions carry the same weight, so a document's contribution
+    // can be taken back exactly when it is removed
+    if (adjustWeight(topic1, topic2, 1)) {
+        adjustWeight(topic2, topic1, 1);
+        return;
+    }
+    
+    touch(topic1);
+    touch(topic2);
+    ownEdges(topic1).push_back(Edge(topic2, 1));
+    ownEdges(topic2).push_back(Edge(topic1, 1));
+}
+
+void Graph::touch(TermId topic) {
+    changedIn[topic / PARTITION_TOPICS] = epoch;
+}
+
+std::vector<Edge>& Graph::ownEdges(TermId topic) {
+    std::vector<Edge>& edges = adjacencyList[topic];
+    if (topic < mappedEdges.size() && !mappedEdges[topic].empty()) {
+        edges.assign(mappedEdges[topic].begin(), mappedEdges[topic].end());
+        mappedEdges[topic] = EdgeList();
+    }
+    return edges;
+}
+
+Graph::EdgeList Graph::getEdges(TermId topic) const {
+    if (topic < mappedEdges.size() && !mappedEdges[topic].empty()) {
+        return mappedEdges[topic];
+    }
+    const std::vector<Edge>& edges = adjacencyList[topic];
+    return EdgeList(edges.data(), edges.data() + edges.size());
+}
+
+void Graph::mapEdges(std::vector<EdgeList>& byTopic) {
+    adjacencyList.clear();
+    adjacencyList.resize(byTopic.size());
+    changedIn.assign((byTopic.size() + PARTITION_TOPICS - 1) / PARTITION_TOPICS, 0);
+    mappedEdges.swap(byTopic);
+    mappedEdges.shrink_to_fit();
+    slotTables.clear();
+}
+
+bool Graph::adjustWeight(TermId from, TermId to, int delta) {
+    auto& edges = ownEdges(from);
+    for (size_t i = 0; i < edges.size(); ++i) {
+        if (edges[i].destination == to) {
+            touch(from);
+            edges[i].weight += delta;
+            if (edges[i].weight <= 0) {
+                edges.erase(edges.begin() + i);
+            }
+            return true;
         }
     }
+    return false;
+}
+
+void Graph::removeEdge(TermId topic1, TermId topic2) {
+    if (topic1 == topic2 || !containsTopic(topic1) || !containsTopic(topic2)) return;
     
-    adjacencyList[topic1].push_back(Edge(topic2, 1));
-    adjacencyList[topic2].push_back(Edge(topic1, 1));
+    adjustWeight(topic1, topic2, -1);
+    adjustWeight(topic2, topic1, -1);
 }
 
-void Graph::addTopic(const std::string& topic) {
-    if (adjacencyList.find(topic) == adjacencyList.end()) {
-        adjacencyList[topic] = std::vector<Edge>();
+void Graph::addTopic(TermId topic) {
+    if (topic >= adjacencyList.size()) {
+        size_t grown = adjacencyList.size() / PARTITION_TOPICS;
+        adjacencyList.resize(topic + 1);
+        changedIn.resize(topic / PARTITION_TOPICS + 1, 0);
+        std::fill(changedIn.begin() + grown, changedIn.end(), epoch);
     }
 }
 
-std::vector<std::pair<std::string, int>> Graph::getRelatedTopics(const std::string& topic, int maxDepth) {
-    std::vector<std::pair<std::string, int>> related;
-    if (adjacencyList.find(topic) == adjacencyList.end()) {
+std::vector<std::pair<TermId, int>> Graph::getRelatedTopics(TermId topic, int maxDepth) const {
+    std::vector<std::pair<TermId, int>> related;
+    if (!containsTopic(topic)) {
         return related;
     }
     
-    std::queue<std::pair<std::string, int>> q;
-    std::unordered_set<std::string> visited;
+    std::queue<std::pair<TermId, int>> q;
+    std::unordered_set<TermId> visited;
     
     q.push({topic, 0});
     visited.insert(topic);
@@ -44,7 +106,7 @@ std::vector<std::pair<std::string, int>> Graph::getRelatedTopics(const std::stri
         q.pop();
         
         if (depth > 0 && depth <= maxDepth) {
-            for (const auto& edge : adjacencyList[current]) {
+            for (const auto& edge : getEdges(current)) {
                 if (visited.find(edge.destination) == visited.end()) {
                     related.push_back({edge.destination, edge.weight});
                 }
@@ -52,7 +114,7 @@ std::vector<std::pair<std::string, int>> Graph::getRelatedTopics(const std::stri
         }
         
         if (depth < maxDepth) {
-            for (const auto& edge : adjacencyList[current]) {
+            for (const auto& edge : getEdges(current)) {
                 if (visited.find(edge.destination) == visited.end()) {
                     visited.insert(edge.destination);
                     q.push({edge.destination, depth + 1});
@@ -63,7 +125,7 @@ std::vector<std::pair<std::string, int>> Graph::getRelatedTopics(const std::stri
     
     // Sort by weight and keep top 6
     std::sort(related.begin(), related.end(), 
-              [](const std::pair<std::string, int>& a, const std::pair<std::string, int>& b) { 
+              [](const std::pair<TermId, int>& a, const std::pair<TermId, int>& b) { 
                   return a.second > b.second; 
               });
     
@@ -74,50 +136,170 @@ std::vector<std::pair<std::string, int>> Graph::getRelatedTopics(const std::stri
     return related;
 }
 
-bool Graph::containsTopic(const std::string& topic) {
-    return adjacencyList.find(topic) != adjacencyList.end();
+bool Graph::containsTopic(TermId topic) const {
+    return topic < adjacencyList.size();
 }
 
-void Graph::incrementEdgeWeight(const std::string& topic1, const std::string& topic2) {
+void Graph::incrementEdgeWeight(TermId topic1, TermId topic2) {
     addEdge(topic1, topic2);
 }
 
-const std::unordered_map<std::string, std::vector<Edge>>& Graph::getAdjacencyList() const {
-    return adjacencyList;
+void Graph::decrementEdgeWeight(TermId topic1, TermId topic2) {
+    removeEdge(topic1, topic2);
 }
 
-void Graph::setAdjacencyList(const std::unordered_map<std::string, std::vector<Edge>>& newList) {
-    adjacencyList = newList;
+void Graph::addEdgeWeights(const std::vector<EdgeCount>& counts, ThreadPool* pool) {
+    // Each direction goes to the group owning its source topic, so groups
+    // can run in parallel without sharing an adjacency list; within a group
+    // updates keep their order, and new edges are appended just as one
+    // addEdge call per pair would have appended them
+    size_t groups = pool != nullptr ? pool->size() : 1;
+    std::vector<std::vector<WeightUpdate>> buckets(groups);
+    TermId largest = 0;
+    bool any = false;
+    for (const auto& count : counts) {
+        if (count.first == count.second || count.count == 0) {
+            continue;
+        }
+        largest = std::max(largest, std::max(count.first, count.second));
+        any = true;
+        WeightUpdate forward = {count.first, count.second, count.count};
+        WeightUpdate backward = {count.second, count.first, count.count};
+        buckets[count.first % groups].push_back(forward);
+        buckets[count.second % groups].push_back(backward);
+    }
+    if (!any) {
+        return;
+    }
+    addTopic(largest);
+    for (const auto& bucket : buckets) {
+        for (const auto& update : bucket) {
+            touch(update.from); // here, since the groups below share partitions
+        }
+    }
+    
+    if (slotTables.size() < groups) {
+        slotTables.resize(groups);
+    }
+    if (pool == nullptr) {
+        applyUpdates(buckets[0], slotTables[0]);
+        return;
+    }
+    for (size_t g = 0; g < groups; ++g) {
+        if (!buckets[g].empty()) {
+            std::vector<WeightUpdate>* updates = &buckets[g];
+            std::vector<uint32_t>* slots = &slotTables[g];
+            pool->submit([this, updates, slots] {
+                applyUpdates(*updates, *slots);
+            });
+        }
+    }
+    pool->wait();
+}
+
+void Graph::applyUpdates(std::vector<WeightUpdate>& updates, std::vector<uint32_t>& slots) {
+    // Updates are grouped by source topic, keeping their order within it.
+    // Each touched list is indexed once into the group's table of
+    // positions, so no update has to scan it, and only its entries are
+    // cleared afterwards: a small batch costs what it touches, not the
+    // size of the vocabulary.
+    std::stable_sort(updates.begin(), updates.end(),
+                     [](const WeightUpdate& a, const WeightUpdate& b) { return a.from < b.from; });
+    if (slots.size() < adjacencyList.size()) {
+        slots.resize(adjacencyList.size(), 0);
+    }
+    
+    for (size_t begin = 0; begin < updates.size();) {
+        TermId topic = updates[begin].from;
+        auto& edges = ownEdges(topic);
+        for (size_t i = 0; i < edges.size(); ++i) {
+            slots[edges[i].destination] = static_cast<uint32_t>(i + 1);
+        }
+        
+        bool prune = false;
+        size_t end = begin;
+        for (; end < updates.size() && updates[end].from == topic; ++end) {
+            const WeightUpdate& update = updates[end];
+            uint32_t& slot = slots[update.to];
+            if (slot != 0) {
+                edges[slot - 1].weight += update.delta;
+                prune = prune || update.delta < 0;
+            } else if (update.delta > 0) {
+                edges.push_back(Edge(update.to, update.delta));
+                slot = static_cast<uint32_t>(edges.size());
+            }
+        }
+        
+        for (const auto& edge : edges) {
+            slots[edge.destination] = 0;
+        }
+        if (prune) {
+            edges.erase(std::remove_if(edges.begin(), edges.end(),
+                                       [](const Edge& edge) { return edge.weight <= 0; }),
+                        edges.end());
+        }
+        begin = end;
+    }
 }
 
-std::vector<std::string> Graph::getAllTopics() const {
-    std::vector<std::string> topics;
-    for (const auto& pair : adjacencyList) {
-        topics.push_back(pair.first);
+size_t Graph::pruneEdges(int minWeight) {
+    // Both directions of an edge carry the same weight, so they go together.
+    // Mapped lists with nothing to drop are left in place.
+    auto light = [minWeight](const Edge& edge) { return edge.weight < minWeight; };
+    size_t removed = 0;
+    for (TermId topic = 0; topic < adjacencyList.size(); ++topic) {
+        EdgeList list = getEdges(topic);
+        if (std::none_of(list.begin(), list.end(), light)) {
+            continue;
+        }
+        auto& edges = ownEdges(topic);
+        size_t before = edges.size();
+        touch(topic);
+        edges.erase(std::remove_if(edges.begin(), edges.end(), light), edges.end());
+        removed += before - edges.size();
+        edges.shrink_to_fit();
+    }
+    return removed / 2;
+}
+
+size_t Graph::byteSize() const {
+    size_t bytes = adjacencyList.capacity() * sizeof(std::vector<Edge>);
+    for (const auto& edges : adjacencyList) {
+        bytes += edges.capacity() * sizeof(Edge);
+    }
+    for (const auto& slots : slotTables) {
+        bytes += slots.capacity() * sizeof(uint32_t);
+    }
+    return bytes + mappedEdges.capacity() * sizeof(EdgeList);
+}
+
+std::vector<TermId> Graph::getAllTopics() const {
+    std::vector<TermId> topics;
+    for (TermId topic = 0; topic < adjacencyList.size(); ++topic) {
+        topics.push_back(topic);
     }
     return topics;
 }
 
-void Graph::dfsCluster(const std::string& node, std::unordered_set<std::string>& visited, 
-                      std::vector<std::string>& cluster, int minWeight) {
-    visited.insert(node);
+void Graph::dfsCluster(TermId node, std::vector<bool>& visited, 
+                      std::vector<TermId>& cluster, int minWeight) const {
+    visited[node] = true;
     cluster.push_back(node);
     
-    for (const auto& edge : adjacencyList[node]) {
-        if (edge.weight >= minWeight && visited.find(edge.destination) == visited.end()) {
+    for (const auto& edge : getEdges(node)) {
+        if (edge.weight >= minWeight && !visited[edge.destination]) {
             dfsCluster(edge.destination, visited, cluster, minWeight);
         }
     }
 }
 
-std::vector<std::vector<std::string>> Graph::findTopicClusters(int minWeight) {
-    std::vector<std::vector<std::string>> clusters;
-    std::unordered_set<std::string> visited;
+std::vector<std::vector<TermId>> Graph::findTopicClusters(int minWeight) const {
+    std::vector<std::vector<TermId>> clusters;
+    std::vector<bool> visited(adjacencyList.size(), false);
     
-    for (const auto& pair : adjacencyList) {
-        const std::string& topic = pair.first;
-        if (visited.find(topic) == visited.end()) {
-            std::vector<std::string> cluster;
+    for (TermId topic = 0; topic < adjacencyList.size(); ++topic) {
+        if (!visited[topic]) {
+            std::vector<TermId> cluster;
             dfsCluster(topic, visited, cluster, minWeight);
             if (cluster.size() > 1) {
                 clusters.push_back(cluster);
@@ -126,7 +308,7 @@ std::vector<std::vector<std::string>> Graph::findTopicClusters(int minWeight) {
     }
     
     std::sort(clusters.begin(), clusters.end(),
-              [](const std::vector<std::string>& a, const std::vector<std::string>& b) {
+              [](const std::vector<TermId>& a, const std::vector<TermId>& b) {
                   return a.size() > b.size();
               });
     
@@ -135,16 +317,16 @@ std::vector<std::vector<std::string>> Graph::findTopicClusters(int minWeight) {
 
 // =========== NEW IMPROVED METHODS ===========
 
-std::vector<std::string> Graph::getLearningPath(const std::string& startTopic, int maxTopics) {
-    std::vector<std::string> learningPath;
+std::vector<TermId> Graph::getLearningPath(TermId startTopic, int maxTopics) const {
+    std::vector<TermId> learningPath;
     
-    if (adjacencyList.find(startTopic) == adjacencyList.end()) {
+    if (!containsTopic(startTopic)) {
         return learningPath;
     }
 
     // Use priority queue: prioritize by connection strength and depth
     struct NodeInfo {
-        std::string topic;
+        TermId topic;
         int weight;
         int depth;
         
@@ -155,7 +337,7 @@ std::vector<std::string> Graph::getLearningPath(const std::string& startTopic, i
     };
 
     std::priority_queue<NodeInfo> pq;
-    std::unordered_set<std::string> visited;
+    std::unordered_set<TermId> visited;
     
     pq.push({startTopic, 0, 0});
     visited.insert(startTopic);
@@ -168,7 +350,8 @@ std::vector<std::string> Graph::getLearningPath(const std::string& startTopic, i
         if (learningPath.size() >= maxTopics) break;
         
         // Get and sort neighbors by weight
-        std::vector<Edge> neighbors = adjacencyList[current.topic];
+        EdgeList edges = getEdges(current.topic);
+        std::vector<Edge> neighbors(edges.begin(), edges.end());
         std::sort(neighbors.begin(), neighbors.end(),
                   [](const Edge& a, const Edge& b) {
                       return a.weight > b.weight;
@@ -188,17 +371,17 @@ std::vector<std::string> Graph::getLearningPath(const std::string& startTopic, i
     return learningPath;
 }
 
-void Graph::displayMindMap(const std::string& startTopic, int maxDepth) const {
-    if (adjacencyList.find(startTopic) == adjacencyList.end()) {
+void Graph::displayMindMap(TermId startTopic, const TermDictionary& terms, int maxDepth) const {
+    if (!containsTopic(startTopic)) {
         std::cout << "Topic not found in knowledge base." << std::endl;
         return;
     }
     
-    std::cout << "\n🧠 Mind Map: " << startTopic << std::endl;
+    std::cout << "\n🧠 Mind Map: " << terms.getTerm(startTopic) << std::endl;
     std::cout << "═══════════════════════════════════\n";
     
-    std::function<void(const std::string&, int, std::vector<bool>)> printTree;
-    printTree = [&](const std::string& node, int depth, std::vector<bool> last) {
+    std::function<void(TermId, int, std::vector<bool>)> printTree;
+    printTree = [&](TermId node, int depth, std::vector<bool> last) {
         // Print current node with indentation
         for (int i = 0; i < depth; i++) {
             if (i == depth - 1) {
@@ -209,10 +392,10 @@ void Graph::displayMindMap(const std::string& startTopic, int maxDepth) const {
         }
         
         if (depth > 0) {
-            std::cout << node;
+            std::cout << terms.getTerm(node);
             // Show connection strength for immediate children
-            if (depth == 1 && adjacencyList.find(startTopic) != adjacencyList.end()) {
-                for (const auto& edge : adjacencyList.at(startTopic)) {
+            if (depth == 1) {
+                for (const auto& edge : getEdges(startTopic)) {
                     if (edge.destination == node) {
                         std::cout << " [" << edge.weight << "]";
                         break;
@@ -220,15 +403,16 @@ void Graph::displayMindMap(const std::string& startTopic, int maxDepth) const {
                 }
             }
         } else {
-            std::cout << "● " << node;
+            std::cout << "● " << terms.getTerm(node);
         }
         std::cout << std::endl;
         
         if (depth >= maxDepth) return;
         
         // Get and sort children by weight
-        if (adjacencyList.find(node) != adjacencyList.end()) {
-            auto children = adjacencyList.at(node);
+        if (containsTopic(node)) {
+            EdgeList edges = getEdges(node);
+            std::vector<Edge> children(edges.begin(), edges.end());
             std::sort(children.begin(), children.end(),
                       [](const Edge& a, const Edge& b) { return a.weight > b.weight; });
             
@@ -246,8 +430,8 @@ void Graph::displayMindMap(const std::string& startTopic, int maxDepth) const {
     std::cout << "\n● = Main topic, [n] = Connection strength\n";
 }
 
-bool Graph::exportMindMap(const std::string& startTopic, const std::string& filename, int maxDepth) const {
-    if (adjacencyList.find(startTopic) == adjacencyList.end()) {
+bool Graph::exportMindMap(TermId startTopic, const TermDictionary& terms, const std::string& filename, int maxDepth) const {
+    if (!containsTopic(startTopic)) {
         return false;
     }
     
@@ -259,27 +443,29 @@ bool Graph::exportMindMap(const std::string& startTopic, const std::string& file
     dotFile << "  node [shape=box, style=filled, fillcolor=lightblue];\n";
     dotFile << "  edge [penwidth=2];\n\n";
     
-    std::queue<std::pair<std::string, int>> q;
-    std::unordered_set<std::string> visited;
+    std::queue<std::pair<TermId, int>> q;
+    std::unordered_set<TermId> visited;
     
     q.push(std::make_pair(startTopic, 0));
     visited.insert(startTopic);
     
     while (!q.empty()) {
         auto currentPair = q.front();
-        std::string current = currentPair.first;
+        TermId current = currentPair.first;
         int depth = currentPair.second;
         q.pop();
         
-        dotFile << "  \"" << current << "\" [label=\"" << current << "\"];\n";
+        const std::string& name = terms.getTerm(current);
+        dotFile << "  \"" << name << "\" [label=\"" << name << "\"];\n";
         
-        if (depth < maxDepth && adjacencyList.find(current) != adjacencyList.end()) {
-            auto neighbors = adjacencyList.at(current);
+        if (depth < maxDepth) {
+            EdgeList edges = getEdges(current);
+            std::vector<Edge> neighbors(edges.begin(), edges.end());
             std::sort(neighbors.begin(), neighbors.end(),
                       [](const Edge& a, const Edge& b) { return a.weight > b.weight; });
             
             for (const auto& edge : neighbors) {
-                dotFile << "  \"" << current << "\" -> \"" << edge.destination 
+                dotFile << "  \"" << name << "\" -> \"" << terms.getTerm(edge.destination) 
                        << "\" [label=\"" << edge.weight << "\", weight=" << edge.weight << "];\n";
                 
                 if (visited.find(edge.destination) == visited.end()) {
@@ -7,36 +7,99 @@
 #include <vector>
 #include <queue>
 #include <utility>
+#include "termdictionary.h"
+#include "threadpool.h"
 
 struct Edge {
-    std::string destination;
+    TermId destination;
     int weight;
     
-    Edge() : destination(""), weight(0) {}  // ADD DEFAULT CONSTRUCTOR
-    Edge(const std::string& dest, int w) : destination(dest), weight(w) {}
+    Edge() : destination(INVALID_TERM), weight(0) {}  // ADD DEFAULT CONSTRUCTOR
+    Edge(TermId dest, int w) : destination(dest), weight(w) {}
+};
+
+// Weight to add to the edge between two topics
+struct EdgeCount {
+    TermId first;
+    TermId second;
+    int count;
 };
 
 class Graph {
+public:
+    // One topic's edges, wherever they are kept
+    struct EdgeList {
+        const Edge* first;
+        const Edge* last;
+        
+        EdgeList() : first(nullptr), last(nullptr) {}
+        EdgeList(const Edge* begin, const Edge* end) : first(begin), last(end) {}
+        const Edge* begin() const { return first; }
+        const Edge* end() const { return last; }
+        size_t size() const { return last - first; }
+        bool empty() const { return first == last; }
+    };
+    
 private:
-    std::unordered_map<std::string, std::vector<Edge>> adjacencyList;
-    void dfsCluster(const std::string& node, std::unordered_set<std::string>& visited, 
-                   std::vector<std::string>& cluster, int minWeight);
+    struct WeightUpdate {
+        TermId from;
+        TermId to;
+        int delta;
+    };
+    
+    std::vector<std::vector<Edge>> adjacencyList; // indexed by TermId
+    // Edges read in place from a saved index, by TermId; a topic's list is
+    // copied into adjacencyList the first time it changes
+    std::vector<EdgeList> mappedEdges;
+    // Checkpoint epoch of the last change to each partition of topics, so a
+    // save can skip the ones it already holds
+    std::vector<uint64_t> changedIn;
+    uint64_t epoch;
+    // One per group of addEdgeWeights, kept between calls: the position + 1
+    // of each destination in the list being updated, all 0 in between
+    std::vector<std::vector<uint32_t>> slotTables;
+    std::vector<Edge>& ownEdges(TermId topic);
+    void touch(TermId topic);
+    bool adjustWeight(TermId from, TermId to, int delta);
+    void applyUpdates(std::vector<WeightUpdate>& updates, std::vector<uint32_t>& slots);
+    void dfsCluster(TermId node, std::vector<bool>& visited, 
+                   std::vector<TermId>& cluster, int minWeight) const;
     
 public:
-    void addEdge(const std::string& topic1, const std::string& topic2);
-    void addTopic(const std::string& topic);
-    std::vector<std::pair<std::string, int>> getRelatedTopics(const std::string& topic, int maxDepth = 2);
-    bool containsTopic(const std::string& topic);
-    void incrementEdgeWeight(const std::string& topic1, const std::string& topic2);
-    const std::unordered_map<std::string, std::vector<Edge>>& getAdjacencyList() const;
-    void setAdjacencyList(const std::unordered_map<std::string, std::vector<Edge>>& newList);
-    std::vector<std::string> getAllTopics() const;
-    std::vector<std::vector<std::string>> findTopicClusters(int minWeight = 2);
+    static const size_t PARTITION_TOPICS = 1 << 14;
+    
+    Graph() : epoch(1) {}
+    
+    void addEdge(TermId topic1, TermId topic2);
+    void removeEdge(TermId topic1, TermId topic2);
+    void addTopic(TermId topic);
+    std::vector<std::pair<TermId, int>> getRelatedTopics(TermId topic, int maxDepth = 2) const;
+    bool containsTopic(TermId topic) const;
+    void incrementEdgeWeight(TermId topic1, TermId topic2);
+    void decrementEdgeWeight(TermId topic1, TermId topic2);
+    // Adds many weights at once (negative counts take weight back), looking
+    // at each touched adjacency list once; an edge ending at zero is dropped
+    void addEdgeWeights(const std::vector<EdgeCount>& counts, ThreadPool* pool = nullptr);
+    // Drops every edge lighter than minWeight and returns how many went.
+    // Their weight is gone for good: taking a document back out later only
+    // lowers the edges that are left.
+    size_t pruneEdges(int minWeight);
+    size_t byteSize() const;
+    size_t topicCount() const { return adjacencyList.size(); }
+    EdgeList getEdges(TermId topic) const;
+    // Replaces the graph with edge lists in memory the caller keeps alive,
+    // such as a mapped index file
+    void mapEdges(std::vector<EdgeList>& byTopic);
+    // Changes from now on are stamped with this epoch
+    void setEpoch(uint64_t current) { epoch = current; }
+    uint64_t partitionChanged(size_t partition) const { return changedIn[partition]; }
+    std::vector<TermId> getAllTopics() const;
+    std::vector<std::vector<TermId>> findTopicClusters(int minWeight = 2) const;
     
     // New methods for learning path and mind map
-    std::vector<std::string> getLearningPath(const std::string& startTopic, int maxTopics = 8);
-    void displayMindMap(const std::string& startTopic, int maxDepth = 2) const;
-    bool exportMindMap(const std::string& startTopic, const std::string& filename, int maxDepth = 2) const;
+    std::vector<TermId> getLearningPath(TermId startTopic, int maxTopics = 8) const;
+    void displayMindMap(TermId startTopic, const TermDictionary& terms, int maxDepth = 2) const;
+    bool exportMindMap(TermId startTopic, const TermDictionary& terms, const std::string& filename, int maxDepth = 2) const;
 };
 
 #endif
\ No newline at end of file
@@ -1,55 +1,193 @@
 #include "hashmap.h"
+#include <algorithm>
+#include "utils.h"
 
-void HashMap::addKeyword(const std::string& keyword, const std::string& filename) {
-    for (auto& fileInfo : keywordIndex[keyword]) {
-        if (fileInfo.filename == filename) {
-            fileInfo.frequency++;
-            return;
+void HashMap::addKeyword(TermId keyword, DocId doc, uint32_t frequency) {
+    Shard& shard = shards[shardOf(keyword)];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    shard.postings[keyword].add(doc, frequency);
+}
+
+void HashMap::addDocument(DocId doc, const TermCounts& termCounts) {
+    // One posting per distinct term, however often it occurs in the document
+    for (const auto& pair : termCounts) {
+        addKeyword(pair.first, doc, pair.second);
+    }
+}
+
+void HashMap::addDocuments(const std::vector<DocId>& docs, const std::vector<TermCounts>& termCounts, ThreadPool& pool) {
+    struct Entry {
+        TermId term;
+        DocId doc;
+        uint32_t frequency;
+    };
+    
+    // Entries are bucketed by shard in document order, then each shard is
+    // filled by one task holding its lock, so every posting list ends up
+    // exactly as serial insertion would have left it
+    std::vector<std::vector<Entry>> buckets(SHARD_COUNT);
+    for (size_t i = 0; i < docs.size(); ++i) {
+        for (const auto& pair : termCounts[i]) {
+            Entry entry = {pair.first, docs[i], pair.second};
+            buckets[shardOf(pair.first)].push_back(entry);
+        }
+    }
+    
+    for (size_t index = 0; index < SHARD_COUNT; ++index) {
+        if (buckets[index].empty()) {
+            continue;
+        }
+        Shard* shard = &shards[index];
+        const std::vector<Entry>* bucket = &buckets[index];
+        pool.submit([this, shard, bucket] {
+            std::lock_guard<std::mutex> guard(shard->lock);
+            for (const auto& entry : *bucket) {
+                shard->postings[entry.term].add(entry.doc, entry.frequency);
+            }
+        });
+    }
+    pool.wait();
+}
+
+std::vector<Posting> HashMap::getFiles(TermId keyword) {
+    if (containsKeyword(keyword)) {
+        return getPostings(keyword)->decode();
+    }
+    return std::vector<Posting>();
+}
+
+const PostingList* HashMap::getPostings(TermId keyword) const {
+    const Shard& shard = shards[shardOf(keyword)];
+    auto found = shard.postings.find(keyword);
+    if (found != shard.postings.end() && !found->second.empty()) {
+        return &found->second;
+    }
+    return nullptr;
+}
+
+std::vector<TermId> HashMap::termIds() const {
+    std::vector<TermId> terms;
+    for (size_t i = 0; i < SHARD_COUNT; ++i) {
+        for (const auto& entry : shards[i].postings) {
+            if (!entry.second.empty()) {
+                terms.push_back(entry.first);
+            }
         }
     }
-    keywordIndex[keyword].push_back(FileInfo(filename, 1));
+    std::sort(terms.begin(), terms.end());
+    return terms;
 }
 
-std::vector<FileInfo> HashMap::getFiles(const std::string& keyword) {
-    if (keywordIndex.find(keyword) != keywordIndex.end()) {
-        return keywordIndex[keyword];
+bool HashMap::containsKeyword(TermId keyword) {
+    return getPostings(keyword) != nullptr;
+}
+
+void HashMap::incrementFrequency(TermId keyword, DocId doc) {
+    addKeyword(keyword, doc);
+}
+
+std::vector<PostingList> HashMap::getIndex() const {
+    std::vector<PostingList> index;
+    for (size_t i = 0; i < SHARD_COUNT; ++i) {
+        for (const auto& entry : shards[i].postings) {
+            if (entry.first >= index.size()) {
+                index.resize(entry.first + 1);
+            }
+            index[entry.first] = entry.second;
+        }
     }
-    return std::vector<FileInfo>();
+    return index;
 }
 
-bool HashMap::containsKeyword(const std::string& keyword) {
-    return keywordIndex.find(keyword) != keywordIndex.end();
+void HashMap::setIndex(const std::vector<PostingList>& newIndex) {
+    for (size_t i = 0; i < SHARD_COUNT; ++i) {
+        std::lock_guard<std::mutex> guard(shards[i].lock);
+        shards[i].postings.clear();
+    }
+    for (TermId keyword = 0; keyword < newIndex.size(); ++keyword) {
+        if (newIndex[keyword].empty()) {
+            continue;
+        }
+        Shard& shard = shards[shardOf(keyword)];
+        std::lock_guard<std::mutex> guard(shard.lock);
+        shard.postings[keyword] = newIndex[keyword];
+    }
 }
 
-void HashMap::incrementFrequency(const std::string& keyword, const std::string& filename) {
-    for (auto& fileInfo : keywordIndex[keyword]) {
-        if (fileInfo.filename == filename) {
-            fileInfo.frequency++;
-            return;
+void HashMap::releasePostings(std::vector<TermId>& terms, std::vector<PostingList>& lists) {
+    // Hash order differs between the two copies, so the lists are sorted
+    // by term to come out the same from both
+    std::unique_lock<std::mutex> guards[SHARD_COUNT];
+    std::vector<std::pair<TermId, PostingList*>> order;
+    for (size_t i = 0; i < SHARD_COUNT; ++i) {
+        guards[i] = std::unique_lock<std::mutex>(shards[i].lock);
+        for (auto& entry : shards[i].postings) {
+            if (!entry.second.empty()) {
+                order.push_back(std::make_pair(entry.first, &entry.second));
+            }
         }
     }
-    keywordIndex[keyword].push_back(FileInfo(filename, 1));
+    std::sort(order.begin(), order.end());
+    terms.clear();
+    lists.clear();
+    terms.reserve(order.size());
+    lists.reserve(order.size());
+    for (const auto& entry : order) {
+        terms.push_back(entry.first);
+        lists.push_back(std::move(*entry.second));
+    }
+    for (size_t i = 0; i < SHARD_COUNT; ++i) {
+        std::unordered_map<TermId, PostingList>().swap(shards[i].postings);
+    }
+}
+
+void HashMap::clear() {
+    std::vector<TermId> terms;
+    std::vector<PostingList> lists;
+    releasePostings(terms, lists);
+    std::lock_guard<std::mutex> guard(contentsLock);
+    fileContents.clear();
+    storedBytes = 0;
 }
 
-const std::unordered_map<std::string, std::vector<FileInfo>>& HashMap::getIndex() const {
-    return keywordIndex;
+void HashMap::storeFileContent(DocId doc, const std::shared_ptr<const CompressedText>& content) {
+    std::lock_guard<std::mutex> guard(contentsLock);
+    if (doc >= fileContents.size()) {
+        fileContents.resize(doc + 1);
+    }
+    if (fileContents[doc]) {
+        storedBytes -= fileContents[doc]->byteSize();
+    }
+    fileContents[doc] = content;
+    if (content) {
+        storedBytes += content->byteSize();
+    }
 }
 
-void HashMap::setIndex(const std::unordered_map<std::string, std::vector<FileInfo>>& newIndex) {
-    keywordIndex = newIndex;
+const CompressedText& HashMap::getFileContent(DocId doc) const {
+    static const CompressedText empty;
+    if (hasFileContent(doc)) {
+        return *fileContents[doc];
+    }
+    return empty;
 }
 
-void HashMap::storeFileContent(const std::string& filename, const std::string& content) {
-    fileContents[filename] = content;
+bool HashMap::hasFileContent(DocId doc) const {
+    return doc < fileContents.size() && fileContents[doc] && !fileContents[doc]->empty();
 }
 
-std::string HashMap::getFileContent(const std::string& filename) {
-    if (fileContents.find(filename) != fileContents.end()) {
-        return fileContents[filename];
+size_t HashMap::postingBytes() const {
+    size_t bytes = 0;
+    for (size_t i = 0; i < SHARD_COUNT; ++i) {
+        const auto& postings = shards[i].postings;
+        bytes += postings.bucket_count() * sizeof(void*);
+        for (const auto& entry : postings) {
+            bytes += Utils::hashEntryBytes(sizeof(entry)) + entry.second.byteSize() - sizeof(PostingList);
+        }
     }
-    return "";
+    return bytes;
 }
 
-bool HashMap::hasFileContent(const std::string& filename) {
-    return fileContents.find(filename) != fileContents.end();
+size_t HashMap::contentBytes() const {
+    return storedBytes + fileContents.capacity() * sizeof(std::shared_ptr<const CompressedText>);
 }
\ No newline at end of file
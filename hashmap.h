@@ -4,7 +4,16 @@
 #include <string>
 #include <unordered_map>
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include "termdictionary.h"
+#include "documenttable.h"
+#include "postinglist.h"
+#include "threadpool.h"
+#include "compressedtext.h"
 
+// A search hit with its filename resolved, built only for returned results
 struct FileInfo {
     std::string filename;
     int frequency;
@@ -12,23 +21,58 @@ struct FileInfo {
     FileInfo(const std::string& file, int freq) : filename(file), frequency(freq) {}
 };
 
-class HashMap {
+// The mutable segment: postings of the newest documents, until the engine
+// freezes them into a Segment. They are split into SHARD_COUNT partitions by
+// term id, each behind its own lock, so writers adding different terms do not
+// wait for each other. A shard holds only the terms the segment's documents
+// use, so its size follows the segment rather than the whole vocabulary.
+// Lookups go straight to the owning shard without locking; they must read an
+// index no writer is touching, which the engine ensures by querying a
+// published snapshot.
+class HashMap : public PostingSource {
+public:
+    static const size_t SHARD_COUNT = 16;
+    typedef std::vector<std::pair<TermId, uint32_t>> TermCounts;
+    
 private:
-    std::unordered_map<std::string, std::vector<FileInfo>> keywordIndex;
-    std::unordered_map<std::string, std::string> fileContents; // Store file contents
+    struct Shard {
+        std::unordered_map<TermId, PostingList> postings;
+        std::mutex lock;
+    };
+    
+    Shard shards[SHARD_COUNT];
+    std::vector<std::shared_ptr<const CompressedText>> fileContents; // Store file contents, indexed by DocId
+    size_t storedBytes; // held by the compressed texts in fileContents
+    std::mutex contentsLock;
+    
+    static size_t shardOf(TermId keyword) { return keyword % SHARD_COUNT; }
     
 public:
-    void addKeyword(const std::string& keyword, const std::string& filename);
-    std::vector<FileInfo> getFiles(const std::string& keyword);
-    bool containsKeyword(const std::string& keyword);
-    void incrementFrequency(const std::string& keyword, const std::string& filename);
-    const std::unordered_map<std::string, std::vector<FileInfo>>& getIndex() const;
-    void setIndex(const std::unordered_map<std::string, std::vector<FileInfo>>& newIndex);
+    HashMap() : storedBytes(0) {}
+    
+    void addKeyword(TermId keyword, DocId doc, uint32_t frequency = 1);
+    void addDocument(DocId doc, const TermCounts& termCounts);
+    void addDocuments(const std::vector<DocId>& docs, const std::vector<TermCounts>& termCounts, ThreadPool& pool);
+    std::vector<Posting> getFiles(TermId keyword);
+    const PostingList* getPostings(TermId keyword) const;
+    std::vector<TermId> termIds() const;
+    bool containsKeyword(TermId keyword);
+    void incrementFrequency(TermId keyword, DocId doc);
+    std::vector<PostingList> getIndex() const; // flattened, indexed by TermId
+    void setIndex(const std::vector<PostingList>& newIndex);
+    // The non-empty lists and their terms in TermId order, leaving no postings behind
+    void releasePostings(std::vector<TermId>& terms, std::vector<PostingList>& lists);
+    void clear();
     
     // New methods for file content storage
-    void storeFileContent(const std::string& filename, const std::string& content);
-    std::string getFileContent(const std::string& filename);
-    bool hasFileContent(const std::string& filename);
+    void storeFileContent(DocId doc, const std::shared_ptr<const CompressedText>& content);
+    const CompressedText& getFileContent(DocId doc) const;
+    bool hasFileContent(DocId doc) const;
+    
+    // Approximate footprint of the mutable postings, and of the kept texts,
+    // which are shared with whoever else holds them
+    size_t postingBytes() const;
+    size_t contentBytes() const;
 };
 
 #endif
\ No newline at end of file
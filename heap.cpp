@@ -74,4 +74,43 @@ std::vector<SearchResult> Heap::getTopK(int k) {
 
 void Heap::clear() {
     heap.clear();
+}
+
+TopKHeap::TopKHeap(size_t k) : capacity(k) {
+    heap.reserve(k);
+}
+
+bool TopKHeap::offer(const SearchResult& result) {
+    // SearchResult::operator< orders by descending relevance, so the standard
+    // heap algorithms keep the least relevant result at the front
+    if (heap.size() < capacity) {
+        heap.push_back(result);
+        std::push_heap(heap.begin(), heap.end());
+        return true;
+    }
+    if (capacity == 0 || result.relevance <= heap.front().relevance) {
+        return false;
+    }
+    std::pop_heap(heap.begin(), heap.end());
+    heap.back() = result;
+    std::push_heap(heap.begin(), heap.end());
+    return true;
+}
+
+bool TopKHeap::full() const {
+    return heap.size() >= capacity;
+}
+
+double TopKHeap::threshold() const {
+    return full() && !heap.empty() ? heap.front().relevance : 0.0;
+}
+
+std::vector<SearchResult> TopKHeap::getSorted() {
+    std::vector<SearchResult> results = heap;
+    std::sort(results.begin(), results.end(),
+              [](const SearchResult& a, const SearchResult& b) {
+                  if (a.relevance != b.relevance) return a.relevance > b.relevance;
+                  return a.docId < b.docId;
+              });
+    return results;
 }
\ No newline at end of file
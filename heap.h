@@ -6,12 +6,15 @@
 #include <algorithm>
 
 struct SearchResult {
-    std::string filename;
+    DocId docId;
+    std::string filename; // resolved only once the result is returned
     int frequency;
     double relevance;
     
     SearchResult(const std::string& file, int freq) 
-        : filename(file), frequency(freq), relevance(freq) {}
+        : docId(INVALID_DOC), filename(file), frequency(freq), relevance(freq) {}
+    SearchResult(DocId doc, int freq, double score)
+        : docId(doc), frequency(freq), relevance(score) {}
     
     bool operator<(const SearchResult& other) const {
         return relevance > other.relevance; // Min-heap based on relevance
@@ -34,4 +37,20 @@ public:
     void clear();
 };
 
+// Keeps only the k most relevant results seen so far. The weakest kept result
+// sits at the root, so a better candidate replaces it in O(log k) and the
+// full candidate list never has to be sorted.
+class TopKHeap {
+private:
+    std::vector<SearchResult> heap;
+    size_t capacity;
+    
+public:
+    explicit TopKHeap(size_t k);
+    bool offer(const SearchResult& result);
+    bool full() const;
+    double threshold() const; // relevance a new result has to beat once full
+    std::vector<SearchResult> getSorted();
+};
+
 #endif
\ No newline at end of file
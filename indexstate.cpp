@@ -0,0 +1,459 @@
+#include "indexstate.h"
+#include <algorithm>
+#include "utils.h"
+#include "binaryio.h"
+
+const size_t IndexState::FREEZE_POSTINGS;
+const size_t IndexState::MERGE_FACTOR;
+const size_t IndexState::DOCUMENT_PARTITION;
+
+void IndexState::applyEdges(std::vector<EdgeCount>& edges, bool remove, ThreadPool* pool) {
+    if (remove) {
+        for (auto& edge : edges) {
+            edge.count = -edge.count;
+        }
+    }
+    topicGraph.addEdgeWeights(edges, pool);
+    edges.clear();
+}
+
+void IndexState::addSentencePairs(const SentenceStream& stream, std::vector<EdgeCount>& edges, bool remove,
+                                  ThreadPool* pool) {
+    // Counting runs a bounded table at a time and the counts go into the
+    // graph whenever it fills, so a large file never needs all of its
+    // distinct pairs in memory at once
+    if (!stream.numbers) {
+        return;
+    }
+    std::unordered_map<uint64_t, size_t> seen;
+    std::vector<uint32_t> sentence;
+    for (uint32_t number : *stream.numbers) {
+        if (number != INVALID_TERM) {
+            sentence.push_back(stream.terms.empty() ? number : stream.terms[number]);
+            continue;
+        }
+        if (seen.size() >= DocumentAnalyzer::PAIR_TABLE_LIMIT) {
+            applyEdges(edges, remove, pool);
+            seen.clear();
+        }
+        DocumentAnalyzer::countPairs(sentence, seen, edges);
+        sentence.clear();
+    }
+}
+
+void IndexState::unlinkDocument(DocId doc) {
+    // Takes the document's pair counts back out of the graph. Kept text is
+    // simply analysed again; documents streamed from disk keep their
+    // sentences, since the file may be gone by now.
+    SentenceStream stream;
+    auto streamed = streamedSentences.find(doc);
+    if (streamed != streamedSentences.end()) {
+        stream = streamed->second;
+        streamedSentences.erase(streamed);
+    } else {
+        stream = sentencesOf(doc);
+    }
+    
+    std::vector<EdgeCount> edges;
+    addSentencePairs(stream, edges, true, nullptr);
+    applyEdges(edges, true, nullptr);
+}
+
+IndexState::SentenceStream IndexState::sentencesOf(DocId doc) const {
+    SentenceStream stream;
+    if (!keywordIndex.hasFileContent(doc)) {
+        return stream;
+    }
+    
+    // Numbered by TermId, so the stream needs no table of its own
+    std::vector<uint32_t> numbers;
+    std::string text = keywordIndex.getFileContent(doc).text();
+    Tokenizer tokenizer(text);
+    size_t currentSentence = 0;
+    while (tokenizer.next()) {
+        if (tokenizer.sentence() != currentSentence) {
+            numbers.push_back(INVALID_TERM);
+            currentSentence = tokenizer.sentence();
+        }
+        numbers.push_back(termDictionary.find(tokenizer.term()));
+    }
+    numbers.push_back(INVALID_TERM);
+    stream.numbers = std::make_shared<const std::vector<uint32_t>>(std::move(numbers));
+    return stream;
+}
+
+void IndexState::commit(const std::vector<AnalyzedDocument>& batch, bool positional, ThreadPool* pool) {
+    std::vector<DocId> docs;
+    std::vector<HashMap::TermCounts> termCounts;
+    std::vector<std::vector<Occurrence>> occurrences;
+    std::vector<TermId> mapping;
+    std::vector<EdgeCount> edges; // graph weights not applied yet
+    
+    // Dictionary, trie, graph and document table are updated in batch order,
+    // so ids and edge weights never depend on how the analysis was scheduled
+    for (const auto& document : batch) {
+        if (!document.error.empty()) {
+            continue;
+        }
+        
+        // Uploading a filename again replaces the earlier version. Pending
+        // weights go in first, so the graph sees uploads strictly in order.
+        DocId previous = documents.find(document.filename);
+        if (previous != INVALID_DOC) {
+            applyEdges(edges, false, pool);
+            removeDocument(previous);
+        }
+        DocId doc = documents.addDocument(document.filename);
+        touchDocument(doc);
+        
+        // New terms are copied once into the dictionary and the trie; every
+        // structure after that works on the integer id
+        HashMap::TermCounts counts;
+        counts.reserve(document.terms.size());
+        mapping.resize(document.terms.size());
+        for (size_t i = 0; i < document.terms.size(); ++i) {
+            bool isNew;
+            mapping[i] = termDictionary.intern(document.terms[i], isNew);
+            if (isNew) {
+                trie.insert(document.terms[i], mapping[i]);
+            }
+            counts.push_back(std::make_pair(mapping[i], document.counts[i]));
+        }
+        
+        // Pair counts of kept text come from the analysing threads; the
+        // whole batch is added to the graph in one pass. Streamed files keep
+        // their sentences for unlinkDocument and are counted from those.
+        if (!mapping.empty()) {
+            topicGraph.addTopic(*std::max_element(mapping.begin(), mapping.end()));
+        }
+        for (const auto& pair : document.pairs) {
+            EdgeCount mapped = {mapping[pair.first], mapping[pair.second], pair.count};
+            edges.push_back(mapped);
+        }
+        if (!document.content) {
+            SentenceStream& stream = streamedSentences[doc];
+            stream.numbers = document.sentences;
+            stream.terms = mapping;
+            addSentencePairs(stream, edges, false, pool);
+        }
+        
+        if (positional) {
+            std::vector<Occurrence> mapped(document.occurrences);
+            for (auto& occurrence : mapped) {
+                occurrence.term = mapping[occurrence.term];
+            }
+            occurrences.push_back(std::move(mapped));
+        }
+        
+        documents.setLength(doc, document.length);
+        keywordIndex.storeFileContent(doc, document.text);
+        if (document.fromFile && document.text) {
+            textSources[doc] = document.source;
+        }
+        docs.push_back(doc);
+        termCounts.push_back(std::move(counts));
+    }
+    
+    applyEdges(edges, false, pool);
+    
+    // A filename repeated within the batch replaced its own earlier entry,
+    // whose postings were never added
+    size_t kept = 0;
+    for (size_t i = 0; i < docs.size(); ++i) {
+        if (documents.isLive(docs[i])) {
+            mutablePostingCount += termCounts[i].size();
+            docs[kept] = docs[i];
+            termCounts[kept].swap(termCounts[i]);
+            if (positional) {
+                occurrences[kept].swap(occurrences[i]);
+            }
+            ++kept;
+        }
+    }
+    docs.resize(kept);
+    termCounts.resize(kept);
+    mutableDocuments += kept;
+    if (positional) {
+        occurrences.resize(kept);
+    }
+    
+    if (pool == nullptr) {
+        // Postings are touched once per distinct term, not once per occurrence
+        for (size_t i = 0; i < docs.size(); ++i) {
+            keywordIndex.addDocument(docs[i], termCounts[i]);
+        }
+    } else {
+        // Occurrence sorting is per document, so it shares the pool with the
+        // sharded posting merge, which waits for both
+        for (auto& document : occurrences) {
+            std::vector<Occurrence>* sorted = &document;
+            pool->submit([sorted] {
+                std::sort(sorted->begin(), sorted->end());
+            });
+        }
+        keywordIndex.addDocuments(docs, termCounts, *pool);
+    }
+    
+    for (size_t i = 0; i < occurrences.size(); ++i) {
+        positions.addDocument(docs[i], occurrences[i]);
+    }
+}
+
+void IndexState::removeDocument(DocId doc) {
+    // Graph weights, positions and text go at once; dictionary terms stay
+    if (!documents.isLive(doc)) {
+        return;
+    }
+    touchDocument(doc);
+    unlinkDocument(doc);
+    positions.removeDocument(doc);
+    keywordIndex.storeFileContent(doc, nullptr);
+    textSources.erase(doc);
+    documents.removeDocument(doc);
+}
+
+std::vector<DocId> IndexState::planEviction(size_t bytes) const {
+    // The sentences cost a number per indexed word, plus one per sentence,
+    // so only text at least twice that size is worth giving up
+    std::vector<DocId> docs;
+    size_t planned = 0;
+    for (DocId doc = 0; doc < documents.size() && planned < bytes; ++doc) {
+        auto source = textSources.find(doc);
+        if (!documents.isLive(doc) || !keywordIndex.hasFileContent(doc) || source == textSources.end()) {
+            continue;
+        }
+        size_t text = keywordIndex.getFileContent(doc).byteSize();
+        size_t sentences = documents.getLength(doc) * sizeof(TermId);
+        if (text < 2 * sentences) {
+            continue;
+        }
+        // Snippets of it are read back from the file from now on
+        FileRecord current;
+        if (DirectorySync::statFile(documents.getFilename(doc), current) && current.size == source->second.size &&
+            current.modified == source->second.modified) {
+            docs.push_back(doc);
+            planned += text - sentences;
+        }
+    }
+    return docs;
+}
+
+void IndexState::evictContent(const std::vector<DocId>& docs, const std::vector<SentenceStream>& streams) {
+    // Documents removed since the eviction was planned are skipped
+    for (size_t i = 0; i < docs.size(); ++i) {
+        if (documents.isLive(docs[i]) && keywordIndex.hasFileContent(docs[i]) && textSources.count(docs[i]) > 0) {
+            touchDocument(docs[i]);
+            streamedSentences[docs[i]] = streams[i];
+            keywordIndex.storeFileContent(docs[i], nullptr);
+            textSources.erase(docs[i]);
+        }
+    }
+}
+
+void IndexState::restore(const Image& image) {
+    // Every term was put in the trie when first interned, so the dictionary
+    // rebuilds it. Saved postings all come back frozen.
+    termDictionary.clear();
+    trie.clear();
+    for (const auto& term : image.terms) {
+        trie.insert(term, termDictionary.intern(term));
+    }
+    std::vector<Graph::EdgeList> edges(image.adjacency);
+    topicGraph.mapEdges(edges);
+    
+    documents.clear();
+    positions.clear();
+    keywordIndex.clear();
+    for (DocId doc = 0; doc < image.filenames.size(); ++doc) {
+        if (!image.live[doc]) {
+            documents.addRemovedDocument();
+            continue;
+        }
+        documents.addDocument(image.filenames[doc]);
+        documents.setLength(doc, image.lengths[doc]);
+        keywordIndex.storeFileContent(doc, image.contents[doc]);
+    }
+    std::vector<PositionIndex::Range> occurrences(image.positions);
+    positions.mapDocuments(occurrences);
+    savedFiles = image.files;
+    
+    streamedSentences = image.sentences;
+    textSources.clear();
+    segments = image.segments;
+    mutableFirst = static_cast<DocId>(documents.size());
+    mutableDocuments = 0;
+    mutablePostingCount = 0;
+    logSequence = image.logSequence;
+    epoch = 1;
+    topicGraph.setEpoch(epoch);
+    documentChanged.assign((documents.size() + DOCUMENT_PARTITION - 1) / DOCUMENT_PARTITION, 0);
+}
+
+void IndexState::touchDocument(DocId doc) {
+    size_t partition = doc / DOCUMENT_PARTITION;
+    if (partition >= documentChanged.size()) {
+        documentChanged.resize(partition + 1, 0);
+    }
+    documentChanged[partition] = epoch;
+}
+
+uint64_t IndexState::beginCheckpoint() {
+    topicGraph.setEpoch(epoch + 1);
+    return epoch++;
+}
+
+MemoryUsage IndexState::memoryUsage() const {
+    MemoryUsage usage;
+    usage.trie = trie.byteSize();
+    usage.dictionary = termDictionary.byteSize();
+    usage.postings = keywordIndex.postingBytes();
+    for (const auto& segment : segments) {
+        usage.segments += segment->byteSize();
+    }
+    usage.contents = keywordIndex.contentBytes();
+    for (const auto& entry : streamedSentences) {
+        const SentenceStream& stream = entry.second;
+        usage.sentences += Utils::hashEntryBytes(sizeof(entry)) + stream.terms.capacity() * sizeof(TermId);
+        if (stream.numbers) {
+            usage.sentences += stream.numbers->capacity() * sizeof(uint32_t);
+        }
+    }
+    usage.graph = topicGraph.byteSize();
+    usage.positions = positions.byteSize();
+    usage.documents = documents.byteSize();
+    usage.documents += textSources.size() * Utils::hashEntryBytes(sizeof(std::pair<const DocId, FileRecord>));
+    for (const auto& file : savedFiles) {
+        usage.mapped += file->size();
+    }
+    return usage;
+}
+
+std::vector<bool> IndexState::liveRange(DocId first, DocId end) const {
+    std::vector<bool> live(end - first);
+    for (DocId doc = first; doc < end; ++doc) {
+        live[doc - first] = documents.isLive(doc);
+    }
+    return live;
+}
+
+size_t IndexState::liveCount(DocId first, DocId end) const {
+    size_t count = 0;
+    for (DocId doc = first; doc < end; ++doc) {
+        count += documents.isLive(doc) ? 1 : 0;
+    }
+    return count;
+}
+
+size_t IndexState::deadDocuments() const {
+    size_t dead = mutableDocuments - liveCount(mutableFirst, static_cast<DocId>(documents.size()));
+    for (const auto& segment : segments) {
+        dead += segment->documentCount() - liveCount(segment->firstDoc(), segment->endDoc());
+    }
+    return dead;
+}
+
+void IndexState::freeze(std::shared_ptr<const Segment>& frozen) {
+    DocId end = static_cast<DocId>(documents.size());
+    if (mutableFirst == end) {
+        return;
+    }
+    
+    // Both copies hold the same mutable postings, so the replay just drops its own
+    std::vector<TermId> terms;
+    std::vector<PostingList> postings;
+    keywordIndex.releasePostings(terms, postings);
+    if (!frozen) {
+        frozen = std::make_shared<Segment>(mutableFirst, end, std::move(terms), std::move(postings), mutableDocuments);
+        if (liveCount(mutableFirst, end) < mutableDocuments) {
+            std::vector<std::shared_ptr<const Segment>> run(1, frozen);
+            frozen = Segment::merge(run, liveRange(mutableFirst, end));
+        }
+    }
+    
+    segments.push_back(frozen);
+    mutableFirst = end;
+    mutableDocuments = 0;
+    mutablePostingCount = 0;
+}
+
+bool IndexState::planMerge(bool purgeAll, std::vector<std::shared_ptr<const Segment>>& run,
+                           std::vector<bool>& live) const {
+    run.clear();
+    
+    // A segment that has lost a tenth of its documents is rewritten on its own
+    for (const auto& segment : segments) {
+        size_t dead = segment->documentCount() - liveCount(segment->firstDoc(), segment->endDoc());
+        if (dead > 0 && (purgeAll || dead * 10 >= segment->documentCount())) {
+            run.push_back(segment);
+            break;
+        }
+    }
+    
+    // Otherwise the newest MERGE_FACTOR adjacent segments of one tier, so
+    // every posting is rewritten once per tier rather than once per freeze
+    if (run.empty() && segments.size() >= MERGE_FACTOR) {
+        // Tiers are MERGE_FACTOR wide with a frozen or freshly merged size
+        // in the middle, so purging a few postings does not change a tier
+        std::vector<size_t> tiers;
+        for (const auto& segment : segments) {
+            size_t tier = 0;
+            for (size_t limit = FREEZE_POSTINGS * MERGE_FACTOR / 2; segment->postingCount() >= limit; limit *= MERGE_FACTOR) {
+                ++tier;
+            }
+            tiers.push_back(tier);
+        }
+        for (size_t first = segments.size() - MERGE_FACTOR + 1; first-- > 0 && run.empty();) {
+            if (std::count(tiers.begin() + first, tiers.begin() + first + MERGE_FACTOR, tiers[first]) ==
+                static_cast<std::ptrdiff_t>(MERGE_FACTOR)) {
+                run.assign(segments.begin() + first, segments.begin() + first + MERGE_FACTOR);
+            }
+        }
+    }
+    
+    if (run.empty()) {
+        return false;
+    }
+    live = liveRange(run.front()->firstDoc(), run.back()->endDoc());
+    return true;
+}
+
+bool IndexState::replaceSegments(const std::vector<std::shared_ptr<const Segment>>& run,
+                                 const std::shared_ptr<const Segment>& merged) {
+    auto first = std::find(segments.begin(), segments.end(), run.front());
+    if (first == segments.end() || static_cast<size_t>(segments.end() - first) < run.size() ||
+        !std::equal(run.begin(), run.end(), first)) {
+        return false;
+    }
+    first = segments.erase(first + 1, first + run.size()) - 1;
+    *first = merged;
+    return true;
+}
+
+std::vector<IndexState::SegmentView> IndexState::segmentViews() const {
+    std::vector<SegmentView> views;
+    for (const auto& segment : segments) {
+        SegmentView view = {segment.get(), segment->firstDoc(), segment->endDoc(), segment->documentCount()};
+        views.push_back(view);
+    }
+    SegmentView current = {&keywordIndex, mutableFirst, static_cast<DocId>(documents.size()), mutableDocuments};
+    views.push_back(current);
+    return views;
+}
+
+size_t IndexState::documentFrequency(TermId keyword) const {
+    size_t frequency = 0;
+    for (const auto& view : segmentViews()) {
+        const PostingList* postings = view.postings->getPostings(keyword);
+        frequency += postings ? postings->size() : 0;
+    }
+    return frequency;
+}
+
+BM25Scorer IndexState::makeScorer() const {
+    return BM25Scorer(documents.liveCount(), documents.averageLength());
+}
+
+QueryEvaluator IndexState::makeEvaluator(const SegmentView& segment, bool positional) const {
+    return QueryEvaluator(termDictionary, *segment.postings, segment.firstDoc, segment.endDoc,
+                          positions, documents, positional);
+}
\ No newline at end of file
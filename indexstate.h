@@ -0,0 +1,172 @@
+#ifndef INDEXSTATE_H
+#define INDEXSTATE_H
+
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <algorithm>
+#include "termdictionary.h"
+#include "documenttable.h"
+#include "trie.h"
+#include "graph.h"
+#include "hashmap.h"
+#include "segment.h"
+#include "positionindex.h"
+#include "bm25.h"
+#include "queryevaluator.h"
+#include "documentanalyzer.h"
+#include "threadpool.h"
+
+// Approximate bytes held by the index, by structure
+struct MemoryUsage {
+    size_t trie;
+    size_t dictionary;
+    size_t postings;  // the mutable segment
+    size_t segments;  // frozen segments
+    size_t contents;  // kept text, compressed
+    size_t sentences; // sentence streams of documents whose text is not kept
+    size_t graph;
+    size_t positions;
+    size_t documents;
+    size_t mapped; // saved index file read in place; page cache, so not in total()
+    
+    MemoryUsage()
+        : trie(0), dictionary(0), postings(0), segments(0), contents(0), sentences(0), graph(0), positions(0),
+          documents(0), mapped(0) {}
+    size_t total() const {
+        return trie + dictionary + postings + segments + contents + sentences + graph + positions + documents;
+    }
+};
+
+// Everything a query reads. The engine keeps two of these behind a Versioned
+// wrapper, so commit() must give the same result every time it is replayed.
+//
+// Postings live in segments: new documents go to the mutable keywordIndex,
+// which freeze() turns into an immutable Segment, and adjacent segments are
+// merged by size tier. Frozen segments are shared by both copies, so only
+// the mutable one is ever written twice. Removing a document only tombstones
+// it in the document table, which every query path checks; its postings stay
+// until the segment holding them is merged.
+class IndexState {
+public:
+    // The sentences of a document whose text is not kept, which is all that
+    // taking its graph weights back out needs. Numbers are split by
+    // INVALID_TERM and shared by both copies.
+    struct SentenceStream {
+        std::shared_ptr<const std::vector<uint32_t>> numbers;
+        std::vector<TermId> terms; // local number -> TermId; empty if the numbers are TermIds
+    };
+    
+private:
+    std::unordered_map<DocId, SentenceStream> streamedSentences;
+    // Kept text read from a file: the file as it was read. Text restored
+    // from a saved index stays mapped, and giving that up frees nothing.
+    std::unordered_map<DocId, FileRecord> textSources;
+    std::vector<std::shared_ptr<const Segment>> segments; // frozen, in DocId order
+    std::vector<std::shared_ptr<const MappedFile>> savedFiles; // restored from; positions and edges point into them
+    DocId mutableFirst;          // first document whose postings are in keywordIndex
+    size_t mutableDocuments;     // documents with postings in keywordIndex
+    size_t mutablePostingCount;
+    uint64_t logSequence;        // last write-ahead log record applied
+    uint64_t epoch;              // checkpoints begun since restore, plus one
+    std::vector<uint64_t> documentChanged; // by DOCUMENT_PARTITION: epoch of the last change
+    
+    void touchDocument(DocId doc);
+    void addSentencePairs(const SentenceStream& stream, std::vector<EdgeCount>& edges, bool remove, ThreadPool* pool);
+    void applyEdges(std::vector<EdgeCount>& edges, bool remove, ThreadPool* pool);
+    void unlinkDocument(DocId doc);
+    std::vector<bool> liveRange(DocId first, DocId end) const;
+    size_t liveCount(DocId first, DocId end) const;
+    
+public:
+    // The mutable segment is frozen once it holds FREEZE_POSTINGS postings;
+    // MERGE_FACTOR adjacent segments of one size tier make one of the next
+    static const size_t FREEZE_POSTINGS = 1 << 16;
+    static const size_t MERGE_FACTOR = 4;
+    // Documents per part of a saved index; a checkpoint rewrites only the
+    // parts whose documents changed
+    static const size_t DOCUMENT_PARTITION = 1024;
+    
+    // One segment as queries see it: postings for the documents in [firstDoc, endDoc)
+    struct SegmentView {
+        const PostingSource* postings;
+        DocId firstDoc;
+        DocId endDoc;
+        size_t documentCount; // documents holding postings in it, removed ones included
+    };
+    
+    // An index read back from disk. restore() installs it in one copy;
+    // segments, text and sentences are shared with the other, and positions,
+    // edges and segment postings are used in place from the mapped file.
+    struct Image {
+        std::vector<std::string> terms;     // by TermId
+        std::vector<std::string> filenames; // by DocId
+        std::vector<bool> live;
+        std::vector<uint32_t> lengths;
+        std::vector<PositionIndex::Range> positions;    // by DocId, in file
+        std::vector<Graph::EdgeList> adjacency;         // by TermId, in file
+        std::vector<std::shared_ptr<const Segment>> segments;
+        std::vector<std::shared_ptr<const CompressedText>> contents; // by DocId
+        std::unordered_map<DocId, SentenceStream> sentences;
+        std::vector<std::shared_ptr<const MappedFile>> files;
+        uint64_t logSequence;
+        
+        Image() : logSequence(0) {}
+    };
+    
+    TermDictionary termDictionary;
+    Trie trie;
+    Graph topicGraph;
+    HashMap keywordIndex; // the mutable segment, plus the kept text of every document
+    PositionIndex positions;
+    DocumentTable documents;
+    
+    IndexState() : mutableFirst(0), mutableDocuments(0), mutablePostingCount(0), logSequence(0), epoch(1) {}
+    
+    void commit(const std::vector<AnalyzedDocument>& batch, bool positional, ThreadPool* pool);
+    void removeDocument(DocId doc);
+    size_t mutablePostings() const { return mutablePostingCount; }
+    size_t deadDocuments() const; // removed, but still holding postings
+    MemoryUsage memoryUsage() const;
+    const std::unordered_map<DocId, SentenceStream>& sentenceStreams() const { return streamedSentences; }
+    void restore(const Image& image); // replaces everything in this copy
+    // Changes up to this write-ahead log sequence are in the index; a saved
+    // copy records it so replaying the log skips what the save already holds
+    void markLogged(uint64_t sequence) { logSequence = std::max(logSequence, sequence); }
+    uint64_t loggedThrough() const { return logSequence; }
+    // Closes the current epoch and returns it. Document and graph parts
+    // changed after that are stamped with a later one, so a checkpoint
+    // taken from here on knows which parts the previous one already holds.
+    uint64_t beginCheckpoint();
+    uint64_t documentsChanged(size_t partition) const { return documentChanged[partition]; }
+    const std::vector<std::shared_ptr<const Segment>>& frozenSegments() const { return segments; }
+    
+    // Kept text is given up oldest document first: planEviction picks
+    // documents whose text is much larger than their sentences and was read
+    // from a file that size and mtime say is still unchanged on disk, enough
+    // to free about the given bytes; sentencesOf analyses one of them, and
+    // evictContent swaps the text for those sentences. The documents are
+    // then treated like files streamed from disk. Text uploaded as is has
+    // nothing to be read back from, so it is never given up.
+    std::vector<DocId> planEviction(size_t bytes) const;
+    SentenceStream sentencesOf(DocId doc) const;
+    void evictContent(const std::vector<DocId>& docs, const std::vector<SentenceStream>& streams);
+    
+    // Moves the mutable postings into a new segment. The first copy to
+    // freeze builds it; replaying with the same pointer shares it.
+    void freeze(std::shared_ptr<const Segment>& frozen);
+    // Picks a run of adjacent segments worth merging and copies the liveness
+    // of its documents; purgeAll picks any segment holding removed documents
+    bool planMerge(bool purgeAll, std::vector<std::shared_ptr<const Segment>>& run, std::vector<bool>& live) const;
+    // False if the run has been replaced in the meantime
+    bool replaceSegments(const std::vector<std::shared_ptr<const Segment>>& run,
+                         const std::shared_ptr<const Segment>& merged);
+    
+    // Frozen segments in DocId order, then the mutable one
+    std::vector<SegmentView> segmentViews() const;
+    size_t documentFrequency(TermId keyword) const;
+    BM25Scorer makeScorer() const;
+    QueryEvaluator makeEvaluator(const SegmentView& segment, bool positional) const;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,158 @@
+// Times indexing a corpus into the keyword index two ways, on one thread:
+// adding a posting for every occurrence of a term (the old path), and
+// counting occurrences per document first, then adding one posting per
+// distinct term (HashMap::addDocument, what uploads do now).
+//
+//     ingest_benchmark [corpus directory] [file count]
+//
+// Defaults: bench_corpus, 10000 files. Missing files are generated first:
+// 25 sentences of 12 terms each, drawn with a Zipf distribution from a
+// 5,000-term vocabulary, with a fixed seed so every run reads the same
+// corpus. The files are read before timing starts, and both paths
+// tokenize the same text into a fresh dictionary and index, so only the
+// posting updates differ. No upload log or save is involved.
+#include "hashmap.h"
+#include "termdictionary.h"
+#include "utils.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+namespace {
+
+const size_t VOCABULARY = 5000;
+const size_t SENTENCES = 25;
+const size_t SENTENCE_TERMS = 12;
+
+bool exists(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+void makeDirectory(const std::string& path) {
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+}
+
+std::vector<std::string> prepareCorpus(const std::string& directory, size_t count) {
+    makeDirectory(directory);
+    std::vector<double> weights;
+    for (size_t rank = 1; rank <= VOCABULARY; ++rank) {
+        weights.push_back(1.0 / rank);
+    }
+    std::discrete_distribution<size_t> zipf(weights.begin(), weights.end());
+    std::mt19937 random(42);
+
+    std::vector<std::string> filenames;
+    size_t written = 0;
+    for (size_t i = 0; i < count; ++i) {
+        std::string filename = directory + "/note" + std::to_string(i) + ".txt";
+        filenames.push_back(filename);
+        // Drawn even for files already there, so the rest come out the same
+        std::string text;
+        for (size_t s = 0; s < SENTENCES; ++s) {
+            for (size_t t = 0; t < SENTENCE_TERMS; ++t) {
+                text += "term" + std::to_string(zipf(random));
+                text += t + 1 < SENTENCE_TERMS ? " " : ". ";
+            }
+        }
+        if (!exists(filename)) {
+            std::ofstream(filename, std::ios::binary) << text;
+            ++written;
+        }
+    }
+    if (written > 0) {
+        std::cout << "Generated " << written << " files in " << directory << "\n";
+    }
+    return filenames;
+}
+
+typedef std::chrono::steady_clock Clock;
+
+bool samePostings(const std::vector<Posting>& a, const std::vector<Posting>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].docId != b[i].docId || a[i].frequency != b[i].frequency) {
+            return false;
+        }
+    }
+    return true;
+}
+
+double seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+double perOccurrence(const std::vector<std::string>& texts, TermDictionary& dictionary, HashMap& index) {
+    Clock::time_point start = Clock::now();
+    for (DocId doc = 0; doc < texts.size(); ++doc) {
+        Tokenizer tokenizer(texts[doc]);
+        while (tokenizer.next()) {
+            index.incrementFrequency(dictionary.intern(tokenizer.term()), doc);
+        }
+    }
+    return seconds(start);
+}
+
+double perDocument(const std::vector<std::string>& texts, TermDictionary& dictionary, HashMap& index) {
+    Clock::time_point start = Clock::now();
+    std::unordered_map<TermId, uint32_t> counts;
+    HashMap::TermCounts termCounts;
+    for (DocId doc = 0; doc < texts.size(); ++doc) {
+        counts.clear();
+        Tokenizer tokenizer(texts[doc]);
+        while (tokenizer.next()) {
+            ++counts[dictionary.intern(tokenizer.term())];
+        }
+        termCounts.assign(counts.begin(), counts.end());
+        index.addDocument(doc, termCounts);
+    }
+    return seconds(start);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string directory = argc > 1 ? argv[1] : "bench_corpus";
+    size_t count = argc > 2 ? std::stoul(argv[2]) : 10000;
+
+    std::vector<std::string> texts;
+    for (const auto& filename : prepareCorpus(directory, count)) {
+        texts.push_back(Utils::readFile(filename));
+    }
+
+    TermDictionary oldTerms;
+    TermDictionary newTerms;
+    HashMap oldIndex;
+    HashMap newIndex;
+    double before = perOccurrence(texts, oldTerms, oldIndex);
+    double after = perDocument(texts, newTerms, newIndex);
+
+    // Both paths must have built the same postings
+    bool same = oldTerms.size() == newTerms.size();
+    for (TermId id = 0; same && id < oldTerms.size(); ++id) {
+        same = samePostings(oldIndex.getFiles(id), newIndex.getFiles(newTerms.find(oldTerms.getTerm(id))));
+    }
+
+    std::cout << "\n=== Indexing " << count << " files, one thread ===\n";
+    std::cout << "Per occurrence: " << before << " s\n";
+    std::cout << "Per document:   " << after << " s\n";
+    std::cout << "Speedup:        " << before / after << "x\n";
+    if (!same) {
+        std::cout << "Error: the two paths built different postings\n";
+        return 1;
+    }
+    return 0;
+}
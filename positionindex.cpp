@@ -0,0 +1,95 @@
+#include "positionindex.h"
+#include <algorithm>
+
+void PositionIndex::addDocument(DocId doc, std::vector<Occurrence>& occurrences) {
+    if (doc >= documents.size()) {
+        documents.resize(doc + 1);
+    }
+    if (!std::is_sorted(occurrences.begin(), occurrences.end())) {
+        std::sort(occurrences.begin(), occurrences.end());
+    }
+    documents[doc].swap(occurrences);
+    documents[doc].shrink_to_fit();
+}
+
+void PositionIndex::mapDocuments(std::vector<Range>& byDoc) {
+    mapped.swap(byDoc);
+    mapped.shrink_to_fit();
+}
+
+void PositionIndex::removeDocument(DocId doc) {
+    if (doc < documents.size()) {
+        std::vector<Occurrence>().swap(documents[doc]);
+    }
+    if (doc < mapped.size()) {
+        mapped[doc] = Range(nullptr, nullptr);
+    }
+}
+
+PositionIndex::Range PositionIndex::getDocument(DocId doc) const {
+    if (doc < documents.size() && !documents[doc].empty()) {
+        const Occurrence* first = documents[doc].data();
+        return Range(first, first + documents[doc].size());
+    }
+    return doc < mapped.size() ? mapped[doc] : Range(nullptr, nullptr);
+}
+
+bool PositionIndex::hasDocument(DocId doc) const {
+    Range occurrences = getDocument(doc);
+    return occurrences.first != occurrences.second;
+}
+
+PositionIndex::Range PositionIndex::find(DocId doc, TermId term) const {
+    Range occurrences = getDocument(doc);
+    if (occurrences.first == occurrences.second) {
+        return Range(nullptr, nullptr);
+    }
+    
+    Occurrence lower(term, 0, 0);
+    Occurrence upper(term, UINT32_MAX, 0);
+    return Range(std::lower_bound(occurrences.first, occurrences.second, lower),
+                 std::upper_bound(occurrences.first, occurrences.second, upper));
+}
+
+size_t PositionIndex::countPhrase(DocId doc, const std::vector<std::pair<TermId, uint32_t>>& phrase) const {
+    // phrase holds (term, position relative to the first phrase word)
+    if (phrase.empty()) {
+        return 0;
+    }
+    
+    std::vector<Range> ranges;
+    for (const auto& word : phrase) {
+        Range range = find(doc, word.first);
+        if (range.first == range.second) {
+            return 0;
+        }
+        ranges.push_back(range);
+    }
+    
+    size_t matches = 0;
+    for (const Occurrence* start = ranges[0].first; start != ranges[0].second; ++start) {
+        bool matched = true;
+        for (size_t i = 1; i < phrase.size() && matched; ++i) {
+            Occurrence wanted(phrase[i].first, start->position + phrase[i].second - phrase[0].second, 0);
+            const Occurrence* hit = std::lower_bound(ranges[i].first, ranges[i].second, wanted);
+            matched = hit != ranges[i].second && hit->position == wanted.position;
+        }
+        if (matched) {
+            ++matches;
+        }
+    }
+    return matches;
+}
+
+void PositionIndex::clear() {
+    documents.clear();
+    mapped.clear();
+}
+
+size_t PositionIndex::byteSize() const {
+    size_t bytes = documents.capacity() * sizeof(std::vector<Occurrence>) + mapped.capacity() * sizeof(Range);
+    for (const auto& occurrences : documents) {
+        bytes += occurrences.capacity() * sizeof(Occurrence);
+    }
+    return bytes;
+}
\ No newline at end of file
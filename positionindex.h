@@ -0,0 +1,48 @@
+#ifndef POSITIONINDEX_H
+#define POSITIONINDEX_H
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "termdictionary.h"
+#include "documenttable.h"
+
+struct Occurrence {
+    TermId term;
+    uint32_t position; // word ordinal in the document
+    uint32_t offset;   // byte offset of the raw word in the document
+    
+    Occurrence() : term(INVALID_TERM), position(0), offset(0) {}
+    Occurrence(TermId t, uint32_t pos, uint32_t off) : term(t), position(pos), offset(off) {}
+    
+    bool operator<(const Occurrence& other) const {
+        if (term != other.term) return term < other.term;
+        return position < other.position;
+    }
+};
+
+// Where each term occurs inside each document, kept per document and sorted
+// by (term, position) so one term's hits form a contiguous range.
+class PositionIndex {
+public:
+    typedef std::pair<const Occurrence*, const Occurrence*> Range;
+    
+private:
+    std::vector<std::vector<Occurrence>> documents; // indexed by DocId
+    std::vector<Range> mapped; // by DocId, read in place from a saved index
+    
+public:
+    void addDocument(DocId doc, std::vector<Occurrence>& occurrences);
+    // Sorted occurrences in memory the caller keeps alive, such as a mapped
+    // index file, replacing any mapped before
+    void mapDocuments(std::vector<Range>& byDoc);
+    Range getDocument(DocId doc) const;
+    void removeDocument(DocId doc);
+    bool hasDocument(DocId doc) const;
+    Range find(DocId doc, TermId term) const;
+    size_t countPhrase(DocId doc, const std::vector<std::pair<TermId, uint32_t>>& phrase) const;
+    void clear();
+    size_t byteSize() const;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,303 @@
+#include "postinglist.h"
+#include <algorithm>
+#include <stdexcept>
+#include "binaryio.h"
+
+const size_t PostingList::BLOCK_SIZE;
+
+namespace {
+
+void writeVarint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t readVarint(const uint8_t*& in) {
+    uint32_t value = 0;
+    int shift = 0;
+    while (*in & 0x80) {
+        value |= static_cast<uint32_t>(*in++ & 0x7F) << shift;
+        shift += 7;
+    }
+    value |= static_cast<uint32_t>(*in++) << shift;
+    return value;
+}
+
+uint8_t bitWidth(uint32_t value) {
+    uint8_t bits = 0;
+    while (value) {
+        ++bits;
+        value >>= 1;
+    }
+    return bits;
+}
+
+void packBits(std::vector<uint8_t>& out, const uint32_t* values, size_t n, uint8_t bits) {
+    uint64_t buffer = 0;
+    unsigned filled = 0;
+    for (size_t i = 0; i < n; ++i) {
+        buffer |= static_cast<uint64_t>(values[i]) << filled;
+        filled += bits;
+        while (filled >= 8) {
+            out.push_back(static_cast<uint8_t>(buffer));
+            buffer >>= 8;
+            filled -= 8;
+        }
+    }
+    if (filled > 0) {
+        out.push_back(static_cast<uint8_t>(buffer));
+    }
+}
+
+void unpackBits(const uint8_t*& in, uint32_t* values, size_t n, uint8_t bits) {
+    uint64_t mask = (static_cast<uint64_t>(1) << bits) - 1;
+    uint64_t buffer = 0;
+    unsigned filled = 0;
+    for (size_t i = 0; i < n; ++i) {
+        while (filled < bits) {
+            buffer |= static_cast<uint64_t>(*in++) << filled;
+            filled += 8;
+        }
+        values[i] = static_cast<uint32_t>(buffer & mask);
+        buffer >>= bits;
+        filled -= bits;
+    }
+}
+
+} // namespace
+
+PostingList::PostingList()
+    : count(0), tailCount(0), tailOffset(0), lastPostingOffset(0),
+      tailMaxFrequency(0), listMaxFrequency(0), lastDoc(0), mappedBlockCount(0), mappedByteCount(0),
+      mappedBlocks(nullptr), mappedData(nullptr) {}
+
+DocId PostingList::tailBase() const {
+    size_t blockTotal = blockCount();
+    return blockTotal == 0 ? 0 : blockTable()[blockTotal - 1].lastDoc;
+}
+
+void PostingList::add(DocId doc, uint32_t frequency) {
+    if (count > 0 && doc == lastDoc) {
+        // The newest posting is always in the tail, so it can be rewritten
+        const uint8_t* in = &data[lastPostingOffset];
+        uint32_t gap = readVarint(in);
+        uint32_t previous = readVarint(in);
+        data.resize(lastPostingOffset);
+        writeVarint(data, gap);
+        writeVarint(data, previous + frequency);
+        tailMaxFrequency = std::max(tailMaxFrequency, previous + frequency);
+        listMaxFrequency = std::max(listMaxFrequency, previous + frequency);
+        return;
+    }
+    
+    if (count == 0 || doc > lastDoc) {
+        append(doc, frequency);
+        return;
+    }
+    
+    // Out-of-order document (e.g. a re-uploaded file): rebuild the list
+    std::vector<Posting> postings = decode();
+    auto it = std::lower_bound(postings.begin(), postings.end(), doc,
+                               [](const Posting& p, DocId d) { return p.docId < d; });
+    if (it != postings.end() && it->docId == doc) {
+        it->frequency += frequency;
+    } else {
+        postings.insert(it, Posting(doc, frequency));
+    }
+    
+    *this = PostingList();
+    for (const auto& posting : postings) {
+        append(posting.docId, posting.frequency);
+    }
+}
+
+void PostingList::append(DocId doc, uint32_t frequency) {
+    if (tailCount == BLOCK_SIZE) {
+        sealTail();
+    }
+    
+    lastPostingOffset = static_cast<uint32_t>(data.size());
+    writeVarint(data, count > 0 ? doc - lastDoc : doc);
+    writeVarint(data, frequency);
+    tailMaxFrequency = std::max(tailMaxFrequency, frequency);
+    listMaxFrequency = std::max(listMaxFrequency, frequency);
+    lastDoc = doc;
+    ++count;
+    ++tailCount;
+}
+
+void PostingList::sealTail() {
+    DocId docs[BLOCK_SIZE];
+    uint32_t freqs[BLOCK_SIZE];
+    size_t n = decodeTail(docs, freqs);
+    
+    uint32_t gaps[BLOCK_SIZE];
+    DocId previous = tailBase();
+    uint32_t maxGap = 0;
+    uint32_t maxFrequency = 0;
+    for (size_t i = 0; i < n; ++i) {
+        gaps[i] = docs[i] - previous;
+        previous = docs[i];
+        maxGap = std::max(maxGap, gaps[i]);
+        maxFrequency = std::max(maxFrequency, freqs[i]);
+        freqs[i] -= 1; // every stored frequency is at least 1
+    }
+    
+    BlockInfo info = BlockInfo(); // padding zeroed too, since blocks are saved as raw bytes
+    info.lastDoc = docs[n - 1];
+    info.offset = tailOffset;
+    info.maxFrequency = maxFrequency;
+    info.docBits = bitWidth(maxGap);
+    info.freqBits = bitWidth(maxFrequency - 1);
+    
+    data.resize(tailOffset);
+    packBits(data, gaps, n, info.docBits);
+    packBits(data, freqs, n, info.freqBits);
+    blocks.push_back(info);
+    
+    tailOffset = static_cast<uint32_t>(data.size());
+    lastPostingOffset = tailOffset;
+    tailCount = 0;
+    tailMaxFrequency = 0;
+}
+
+size_t PostingList::decodeTail(DocId* docs, uint32_t* freqs) const {
+    if (tailCount == 0) {
+        return 0;
+    }
+    
+    const uint8_t* in = bytes() + tailOffset;
+    DocId previous = tailBase();
+    for (uint32_t i = 0; i < tailCount; ++i) {
+        previous += readVarint(in);
+        docs[i] = previous;
+        freqs[i] = readVarint(in);
+    }
+    return tailCount;
+}
+
+std::vector<Posting> PostingList::decode() const {
+    std::vector<Posting> postings;
+    postings.reserve(count);
+    for (Iterator it(*this); it.valid(); it.next()) {
+        postings.push_back(Posting(it.docId(), it.frequency()));
+    }
+    return postings;
+}
+
+size_t PostingList::byteSize() const {
+    return sizeof(*this) + data.capacity() + blocks.capacity() * sizeof(BlockInfo);
+}
+
+void PostingList::shrink() {
+    data.shrink_to_fit();
+    blocks.shrink_to_fit();
+}
+
+void PostingList::write(BinaryWriter& out) const {
+    out.write(count);
+    out.write(tailCount);
+    out.write(tailOffset);
+    out.write(lastPostingOffset);
+    out.write(tailMaxFrequency);
+    out.write(listMaxFrequency);
+    out.write(lastDoc);
+    out.writeAligned(blockTable(), blockCount());
+    out.writeAligned(bytes(), byteCount());
+}
+
+void PostingList::map(BinaryReader& in) {
+    count = in.read<uint32_t>();
+    tailCount = in.read<uint32_t>();
+    tailOffset = in.read<uint32_t>();
+    lastPostingOffset = in.read<uint32_t>();
+    tailMaxFrequency = in.read<uint32_t>();
+    listMaxFrequency = in.read<uint32_t>();
+    lastDoc = in.read<DocId>();
+    uint64_t blockTotal;
+    uint64_t byteTotal;
+    mappedBlocks = in.view<BlockInfo>(blockTotal);
+    mappedData = in.view<uint8_t>(byteTotal);
+    mappedBlockCount = static_cast<uint32_t>(blockTotal);
+    mappedByteCount = static_cast<uint32_t>(byteTotal);
+    if (byteTotal == 0 || byteTotal != mappedByteCount || byteTotal < tailOffset ||
+        tailCount > BLOCK_SIZE || count != blockTotal * BLOCK_SIZE + tailCount) {
+        throw std::runtime_error("Index file is corrupt");
+    }
+    std::vector<uint8_t>().swap(data);
+    std::vector<BlockInfo>().swap(blocks);
+}
+
+PostingList::Iterator::Iterator(const PostingList& postings)
+    : list(&postings), block(0), index(0), bufferSize(0) {
+    loadBlock(0);
+}
+
+void PostingList::Iterator::loadBlock(size_t blockIndex) {
+    block = blockIndex;
+    index = 0;
+    
+    if (block < list->blockCount()) {
+        const BlockInfo& info = list->blockTable()[block];
+        const uint8_t* in = list->bytes() + info.offset;
+        unpackBits(in, docs, BLOCK_SIZE, info.docBits);
+        unpackBits(in, freqs, BLOCK_SIZE, info.freqBits);
+        
+        DocId previous = block == 0 ? 0 : list->blockTable()[block - 1].lastDoc;
+        for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+            previous += docs[i];
+            docs[i] = previous;
+            freqs[i] += 1;
+        }
+        bufferSize = BLOCK_SIZE;
+    } else if (block == list->blockCount()) {
+        bufferSize = list->decodeTail(docs, freqs);
+    } else {
+        bufferSize = 0;
+    }
+}
+
+void PostingList::Iterator::next() {
+    ++index;
+    if (index >= bufferSize && block < list->blockCount()) {
+        loadBlock(block + 1);
+    }
+}
+
+void PostingList::Iterator::advance(DocId target) {
+    if (!valid() || docs[index] >= target) {
+        return;
+    }
+    
+    // Skip whole blocks using their last doc id before decoding anything
+    size_t candidate = block;
+    while (candidate < list->blockCount() && list->blockTable()[candidate].lastDoc < target) {
+        ++candidate;
+    }
+    if (candidate != block) {
+        loadBlock(candidate);
+    }
+    index = std::lower_bound(docs + index, docs + bufferSize, target) - docs;
+}
+
+bool PostingList::Iterator::blockBound(DocId target, uint32_t& maxFrequency, DocId& blockEnd) const {
+    size_t candidate = block;
+    while (candidate < list->blockCount() && list->blockTable()[candidate].lastDoc < target) {
+        ++candidate;
+    }
+    
+    if (candidate < list->blockCount()) {
+        maxFrequency = list->blockTable()[candidate].maxFrequency;
+        blockEnd = list->blockTable()[candidate].lastDoc;
+        return true;
+    }
+    if (list->tailCount > 0 && list->lastDoc >= target) {
+        maxFrequency = list->tailMaxFrequency;
+        blockEnd = list->lastDoc;
+        return true;
+    }
+    return false;
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+#ifndef POSTINGLIST_H
+#define POSTINGLIST_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "documenttable.h"
+#include "termdictionary.h"
+
+class BinaryWriter;
+class BinaryReader;
+
+struct Posting {
+    DocId docId;
+    uint32_t frequency;
+    
+    Posting(DocId doc, uint32_t freq) : docId(doc), frequency(freq) {}
+};
+
+// Postings for one term, sorted by DocId and stored compressed. Every full
+// block of BLOCK_SIZE postings is frame-of-reference bit-packed (doc gaps and
+// frequencies each at the narrowest width that fits the block); the newest
+// postings sit in a variable-byte encoded tail until they fill a block.
+// A list read from a mapped index file points into the file instead of
+// holding its own copy, and must not be added to.
+class PostingList {
+public:
+    static const size_t BLOCK_SIZE = 128;
+    
+    struct BlockInfo {
+        DocId lastDoc;         // skip target: every doc in the block is <= lastDoc
+        uint32_t offset;       // start of the packed block in data
+        uint32_t maxFrequency; // largest frequency in the block
+        uint8_t docBits;
+        uint8_t freqBits;
+    };
+    
+    // Decodes one block at a time while walking the list
+    class Iterator {
+    private:
+        const PostingList* list;
+        size_t block;      // blocks.size() means the varint tail
+        size_t index;
+        size_t bufferSize;
+        DocId docs[BLOCK_SIZE];
+        uint32_t freqs[BLOCK_SIZE];
+        
+        void loadBlock(size_t blockIndex);
+        
+    public:
+        explicit Iterator(const PostingList& postings);
+        bool valid() const { return index < bufferSize; }
+        DocId docId() const { return docs[index]; }
+        uint32_t frequency() const { return freqs[index]; }
+        void next();
+        void advance(DocId target); // first posting with docId >= target
+        
+        // Bounds for the block holding the first posting >= target, read from
+        // block metadata without decoding; false if no such posting exists
+        bool blockBound(DocId target, uint32_t& maxFrequency, DocId& blockEnd) const;
+    };
+    
+    PostingList();
+    
+    void add(DocId doc, uint32_t frequency);
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    uint32_t maxFrequency() const { return listMaxFrequency; }
+    std::vector<Posting> decode() const;
+    Iterator iterator() const { return Iterator(*this); }
+    size_t byteSize() const;
+    void shrink(); // drop spare capacity once the list stops growing
+    
+    // The encoded form as is. map() reads it back in place, so the reader's
+    // file must outlive the list.
+    void write(BinaryWriter& out) const;
+    void map(BinaryReader& in);
+    
+private:
+    std::vector<uint8_t> data;
+    std::vector<BlockInfo> blocks;
+    uint32_t count;
+    uint32_t tailCount;
+    uint32_t tailOffset;        // start of the varint tail in data
+    uint32_t lastPostingOffset; // start of the newest posting in the tail
+    uint32_t tailMaxFrequency;
+    uint32_t listMaxFrequency;
+    DocId lastDoc;
+    uint32_t mappedBlockCount;
+    uint32_t mappedByteCount;
+    const BlockInfo* mappedBlocks; // null unless the list was mapped
+    const uint8_t* mappedData;
+    
+    bool isMapped() const { return mappedData != nullptr; }
+    const BlockInfo* blockTable() const { return isMapped() ? mappedBlocks : blocks.data(); }
+    size_t blockCount() const { return isMapped() ? mappedBlockCount : blocks.size(); }
+    const uint8_t* bytes() const { return isMapped() ? mappedData : data.data(); }
+    size_t byteCount() const { return isMapped() ? mappedByteCount : data.size(); }
+    DocId tailBase() const;
+    void append(DocId doc, uint32_t frequency);
+    void sealTail();
+    size_t decodeTail(DocId* docs, uint32_t* freqs) const;
+};
+
+// Anything queries can look a term's postings up in
+class PostingSource {
+public:
+    virtual ~PostingSource() {}
+    virtual const PostingList* getPostings(TermId keyword) const = 0;
+    // Every term with a non-empty list, in increasing order
+    virtual std::vector<TermId> termIds() const = 0;
+};
+
+#endif
\ No newline at end of file
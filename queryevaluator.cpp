@@ -0,0 +1,309 @@
+#include "queryevaluator.h"
+#include <algorithm>
+#include <iterator>
+
+const size_t QueryEvaluator::GALLOP_RATIO;
+
+QueryEvaluator::QueryEvaluator(const TermDictionary& dictionary, const PostingSource& postings,
+                               DocId first, DocId end, const PositionIndex& positionIndex,
+                               const DocumentTable& documentTable, bool positional)
+    : terms(dictionary), index(postings), firstDoc(first), endDoc(end), positions(positionIndex),
+      documents(documentTable), usePositions(positional) {}
+
+const PostingList* QueryEvaluator::postingsFor(const std::string& term) const {
+    return index.getPostings(terms.find(term));
+}
+
+size_t QueryEvaluator::estimate(const QueryNode& node) const {
+    switch (node.type) {
+        case QueryNode::TERM: {
+            const PostingList* postings = postingsFor(node.terms[0]);
+            return postings ? postings->size() : 0;
+        }
+        case QueryNode::PHRASE: {
+            size_t smallest = static_cast<size_t>(endDoc - firstDoc);
+            for (const auto& term : node.terms) {
+                const PostingList* postings = postingsFor(term);
+                smallest = std::min(smallest, postings ? postings->size() : 0);
+            }
+            return smallest;
+        }
+        case QueryNode::OR: {
+            size_t total = 0;
+            for (const auto& child : node.children) {
+                total += estimate(child);
+            }
+            return std::min(total, static_cast<size_t>(endDoc - firstDoc));
+        }
+        case QueryNode::AND: {
+            size_t smallest = static_cast<size_t>(endDoc - firstDoc);
+            for (const auto& child : node.children) {
+                if (child.type != QueryNode::NOT) {
+                    smallest = std::min(smallest, estimate(child));
+                }
+            }
+            return smallest;
+        }
+        default:
+            return static_cast<size_t>(endDoc - firstDoc);
+    }
+}
+
+std::vector<DocId> QueryEvaluator::allDocuments() const {
+    std::vector<DocId> docs;
+    for (DocId doc = firstDoc; doc < endDoc; ++doc) {
+        if (documents.isLive(doc)) {
+            docs.push_back(doc);
+        }
+    }
+    return docs;
+}
+
+std::vector<DocId> QueryEvaluator::evaluate(const QueryNode& node) {
+    std::vector<DocId> docs;
+    
+    switch (node.type) {
+        case QueryNode::TERM: {
+            const PostingList* postings = postingsFor(node.terms[0]);
+            if (postings != nullptr) {
+                docs.reserve(postings->size());
+                // Tombstoned documents are dropped at the leaves; every
+                // operator above only ever narrows or merges these lists
+                for (PostingList::Iterator it = postings->iterator(); it.valid(); it.next()) {
+                    if (documents.isLive(it.docId())) {
+                        docs.push_back(it.docId());
+                    }
+                }
+            }
+            break;
+        }
+        case QueryNode::PHRASE: {
+            std::vector<std::pair<TermId, uint32_t>> words;
+            for (size_t i = 0; i < node.terms.size(); ++i) {
+                words.push_back({terms.find(node.terms[i]), node.offsets[i]});
+            }
+            for (const auto& match : matchPhrase(words)) {
+                docs.push_back(match.docId);
+            }
+            break;
+        }
+        case QueryNode::OR: {
+            for (const auto& child : node.children) {
+                docs = unite(docs, evaluate(child));
+            }
+            break;
+        }
+        case QueryNode::NOT: {
+            docs = subtract(allDocuments(), evaluate(node.children[0]));
+            break;
+        }
+        case QueryNode::AND:
+            docs = evaluateAnd(node);
+            break;
+    }
+    
+    return docs;
+}
+
+std::vector<DocId> QueryEvaluator::evaluateAnd(const QueryNode& node) {
+    std::vector<const QueryNode*> required;
+    std::vector<const QueryNode*> excluded;
+    for (const auto& child : node.children) {
+        if (child.type == QueryNode::NOT) {
+            excluded.push_back(&child.children[0]);
+        } else {
+            required.push_back(&child);
+        }
+    }
+    
+    // Smallest operand first keeps every intermediate result short
+    std::vector<std::pair<size_t, const QueryNode*>> ordered;
+    for (const QueryNode* child : required) {
+        ordered.push_back({estimate(*child), child});
+    }
+    std::sort(ordered.begin(), ordered.end(),
+              [](const std::pair<size_t, const QueryNode*>& a, const std::pair<size_t, const QueryNode*>& b) {
+                  return a.first < b.first;
+              });
+    
+    std::vector<DocId> docs = ordered.empty() ? allDocuments() : evaluate(*ordered[0].second);
+    for (size_t i = 1; i < ordered.size() && !docs.empty(); ++i) {
+        const QueryNode& child = *ordered[i].second;
+        if (child.type == QueryNode::TERM) {
+            // Intersect against the compressed postings without decoding them up front
+            const PostingList* postings = postingsFor(child.terms[0]);
+            docs = postings ? intersect(docs, *postings) : std::vector<DocId>();
+        } else {
+            docs = intersect(docs, evaluate(child));
+        }
+    }
+    
+    for (size_t i = 0; i < excluded.size() && !docs.empty(); ++i) {
+        const QueryNode& child = *excluded[i];
+        if (child.type == QueryNode::TERM) {
+            const PostingList* postings = postingsFor(child.terms[0]);
+            if (postings != nullptr) {
+                docs = subtract(docs, *postings);
+            }
+        } else {
+            docs = subtract(docs, evaluate(child));
+        }
+    }
+    
+    return docs;
+}
+
+std::vector<Posting> QueryEvaluator::matchPhrase(const std::vector<std::pair<TermId, uint32_t>>& words) const {
+    std::vector<Posting> matches;
+    std::vector<PostingList::Iterator> lists;
+    for (const auto& word : words) {
+        const PostingList* postings = index.getPostings(word.first);
+        if (postings == nullptr) {
+            return matches;
+        }
+        lists.push_back(postings->iterator());
+    }
+    if (lists.empty()) {
+        return matches;
+    }
+    
+    // Leapfrog over the postings to find documents holding every word, then
+    // confirm adjacency from the positional index
+    DocId candidate = 0;
+    bool exhausted = false;
+    while (!exhausted) {
+        bool aligned = true;
+        uint32_t minFrequency = UINT32_MAX;
+        for (auto& it : lists) {
+            it.advance(candidate);
+            if (!it.valid()) {
+                exhausted = true;
+                break;
+            }
+            if (it.docId() > candidate) {
+                candidate = it.docId();
+                aligned = false;
+                break;
+            }
+            minFrequency = std::min(minFrequency, it.frequency());
+        }
+        if (exhausted || !aligned) {
+            continue;
+        }
+        
+        size_t count = 0;
+        if (documents.isLive(candidate)) {
+            count = usePositions ? positions.countPhrase(candidate, words) : minFrequency;
+        }
+        if (count > 0) {
+            matches.push_back(Posting(candidate, static_cast<uint32_t>(count)));
+        }
+        ++candidate;
+    }
+    
+    return matches;
+}
+
+std::vector<DocId> QueryEvaluator::intersect(const std::vector<DocId>& a, const std::vector<DocId>& b) {
+    const std::vector<DocId>& small = a.size() <= b.size() ? a : b;
+    const std::vector<DocId>& large = a.size() <= b.size() ? b : a;
+    std::vector<DocId> result;
+    if (small.empty()) {
+        return result;
+    }
+    
+    if (large.size() / small.size() >= GALLOP_RATIO) {
+        // Exponential probe from the last match, then binary search the bracket
+        size_t lo = 0;
+        for (DocId doc : small) {
+            size_t step = 1;
+            size_t hi = lo;
+            while (hi < large.size() && large[hi] < doc) {
+                lo = hi + 1;
+                hi = lo + step;
+                step <<= 1;
+            }
+            lo = std::lower_bound(large.begin() + lo, large.begin() + std::min(hi + 1, large.size()), doc)
+                 - large.begin();
+            if (lo == large.size()) {
+                break;
+            }
+            if (large[lo] == doc) {
+                result.push_back(doc);
+            }
+        }
+        return result;
+    }
+    
+    // Similar lengths: a merge whose cursor steps do not branch on the comparison
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.size() && j < b.size()) {
+        DocId x = a[i];
+        DocId y = b[j];
+        if (x == y) {
+            result.push_back(x);
+        }
+        i += x <= y;
+        j += y <= x;
+    }
+    return result;
+}
+
+std::vector<DocId> QueryEvaluator::intersect(const std::vector<DocId>& docs, const PostingList& postings) {
+    std::vector<DocId> result;
+    PostingList::Iterator it = postings.iterator();
+    
+    if (postings.size() / std::max<size_t>(docs.size(), 1) >= GALLOP_RATIO) {
+        // Few candidates: skip whole blocks and binary search inside one
+        for (DocId doc : docs) {
+            it.advance(doc);
+            if (!it.valid()) {
+                break;
+            }
+            if (it.docId() == doc) {
+                result.push_back(doc);
+            }
+        }
+        return result;
+    }
+    
+    size_t i = 0;
+    while (i < docs.size() && it.valid()) {
+        DocId x = docs[i];
+        DocId y = it.docId();
+        if (x == y) {
+            result.push_back(x);
+        }
+        i += x <= y;
+        if (y <= x) {
+            it.next();
+        }
+    }
+    return result;
+}
+
+std::vector<DocId> QueryEvaluator::unite(const std::vector<DocId>& a, const std::vector<DocId>& b) {
+    std::vector<DocId> result;
+    result.reserve(a.size() + b.size());
+    std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    return result;
+}
+
+std::vector<DocId> QueryEvaluator::subtract(const std::vector<DocId>& a, const std::vector<DocId>& b) {
+    std::vector<DocId> result;
+    std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    return result;
+}
+
+std::vector<DocId> QueryEvaluator::subtract(const std::vector<DocId>& docs, const PostingList& postings) {
+    std::vector<DocId> result;
+    PostingList::Iterator it = postings.iterator();
+    for (DocId doc : docs) {
+        it.advance(doc);
+        if (!it.valid() || it.docId() != doc) {
+            result.push_back(doc);
+        }
+    }
+    return result;
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef QUERYEVALUATOR_H
+#define QUERYEVALUATOR_H
+
+#include <vector>
+#include <utility>
+#include "queryparser.h"
+#include "termdictionary.h"
+#include "documenttable.h"
+#include "postinglist.h"
+#include "positionindex.h"
+
+// Evaluates a parsed boolean query to the sorted list of matching DocIds.
+// Conjunctions start from the smallest operand and pick an intersection
+// strategy per step: a linear merge when both sides are of similar length,
+// galloping (or block skipping inside compressed postings) when one side is
+// much shorter than the other.
+//
+// An evaluator covers one index segment, the documents in [firstDoc, endDoc);
+// the engine runs one per segment and combines their results.
+class QueryEvaluator {
+private:
+    const TermDictionary& terms;
+    const PostingSource& index;
+    DocId firstDoc;
+    DocId endDoc;
+    const PositionIndex& positions;
+    const DocumentTable& documents;
+    bool usePositions;
+    
+    const PostingList* postingsFor(const std::string& term) const;
+    size_t estimate(const QueryNode& node) const;
+    std::vector<DocId> evaluateAnd(const QueryNode& node);
+    std::vector<DocId> allDocuments() const;
+    
+public:
+    // Above this length ratio the shorter side gallops through the longer
+    static const size_t GALLOP_RATIO = 16;
+    
+    QueryEvaluator(const TermDictionary& dictionary, const PostingSource& postings,
+                   DocId first, DocId end, const PositionIndex& positionIndex,
+                   const DocumentTable& documentTable, bool positional);
+    
+    std::vector<DocId> evaluate(const QueryNode& node);
+    
+    // Documents containing the phrase, with the number of times it occurs;
+    // words holds (term, offset inside the phrase)
+    std::vector<Posting> matchPhrase(const std::vector<std::pair<TermId, uint32_t>>& words) const;
+    
+    static std::vector<DocId> intersect(const std::vector<DocId>& a, const std::vector<DocId>& b);
+    static std::vector<DocId> intersect(const std::vector<DocId>& docs, const PostingList& postings);
+    static std::vector<DocId> unite(const std::vector<DocId>& a, const std::vector<DocId>& b);
+    static std::vector<DocId> subtract(const std::vector<DocId>& a, const std::vector<DocId>& b);
+    static std::vector<DocId> subtract(const std::vector<DocId>& docs, const PostingList& postings);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "queryparser.h"
+#include "utils.h"
+#include <cctype>
+
+void QueryParser::lex(const std::string& query) {
+    tokens.clear();
+    pos = 0;
+    
+    size_t i = 0;
+    while (i < query.size()) {
+        char c = query[i];
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            ++i;
+        } else if (c == '(' || c == ')') {
+            tokens.push_back(std::string(1, c));
+            ++i;
+        } else if (c == '"') {
+            // Phrase tokens keep their opening quote as a marker
+            size_t end = query.find('"', i + 1);
+            if (end == std::string::npos) {
+                end = query.size();
+            }
+            tokens.push_back(query.substr(i, end - i));
+            i = end + 1;
+        } else {
+            size_t start = i;
+            while (i < query.size() && !std::isspace(static_cast<unsigned char>(query[i])) &&
+                   query[i] != '(' && query[i] != ')' && query[i] != '"') {
+                ++i;
+            }
+            tokens.push_back(query.substr(start, i - start));
+        }
+    }
+}
+
+bool QueryParser::peek(const char* token) const {
+    return pos < tokens.size() && tokens[pos] == token;
+}
+
+bool QueryParser::parse(const std::string& query, QueryNode& root) {
+    lex(query);
+    
+    // Stray closing parentheses are skipped and what follows is ANDed on
+    std::vector<QueryNode> parts;
+    while (pos < tokens.size()) {
+        QueryNode part(QueryNode::AND);
+        if (parseQuery(part)) {
+            parts.push_back(part);
+        }
+        if (peek(")")) {
+            ++pos;
+        }
+    }
+    
+    if (parts.empty()) {
+        return false;
+    }
+    if (parts.size() == 1) {
+        root = parts[0];
+    } else {
+        root = QueryNode(QueryNode::AND);
+        root.children = parts;
+    }
+    return true;
+}
+
+bool QueryParser::parseQuery(QueryNode& node) {
+    std::vector<QueryNode> alternatives;
+    while (pos < tokens.size() && !peek(")")) {
+        if (peek("OR")) {
+            ++pos;
+            continue;
+        }
+        QueryNode alternative(QueryNode::AND);
+        if (parseAnd(alternative)) {
+            alternatives.push_back(alternative);
+        }
+    }
+    
+    if (alternatives.empty()) {
+        return false;
+    }
+    if (alternatives.size() == 1) {
+        node = alternatives[0];
+    } else {
+        node = QueryNode(QueryNode::OR);
+        node.children = alternatives;
+    }
+    return true;
+}
+
+bool QueryParser::parseAnd(QueryNode& node) {
+    std::vector<QueryNode> operands;
+    while (pos < tokens.size() && !peek(")") && !peek("OR")) {
+        if (peek("AND")) {
+            ++pos;
+            continue;
+        }
+        QueryNode operand(QueryNode::AND);
+        if (parseUnary(operand)) {
+            operands.push_back(operand);
+        }
+    }
+    
+    if (operands.empty()) {
+        return false;
+    }
+    if (operands.size() == 1) {
+        node = operands[0];
+    } else {
+        node = QueryNode(QueryNode::AND);
+        node.children = operands;
+    }
+    return true;
+}
+
+bool QueryParser::parseUnary(QueryNode& node) {
+    if (peek("NOT")) {
+        ++pos;
+        QueryNode operand(QueryNode::AND);
+        if (!parseUnary(operand)) {
+            return false;
+        }
+        node = QueryNode(QueryNode::NOT);
+        node.children.push_back(operand);
+        return true;
+    }
+    return parsePrimary(node);
+}
+
+bool QueryParser::parsePrimary(QueryNode& node) {
+    if (pos >= tokens.size() || peek(")") || peek("OR")) {
+        return false;
+    }
+    
+    const std::string& token = tokens[pos++];
+    if (token == "(") {
+        bool parsed = parseQuery(node);
+        if (peek(")")) {
+            ++pos;
+        }
+        return parsed;
+    }
+    
+    // Words and phrases go through the indexing tokenizer so they match
+    // exactly what was stored
+    bool isPhrase = token[0] == '"';
+    Tokenizer tokenizer(token.data() + (isPhrase ? 1 : 0), token.size() - (isPhrase ? 1 : 0));
+    QueryNode parsed(QueryNode::PHRASE);
+    size_t firstPosition = 0;
+    while (tokenizer.next()) {
+        if (parsed.terms.empty()) {
+            firstPosition = tokenizer.position();
+        }
+        parsed.terms.push_back(tokenizer.term());
+        parsed.offsets.push_back(static_cast<uint32_t>(tokenizer.position() - firstPosition));
+    }
+    
+    if (parsed.terms.empty()) {
+        return false;
+    }
+    if (parsed.terms.size() == 1) {
+        parsed.type = QueryNode::TERM;
+        parsed.offsets.clear();
+    }
+    node = parsed;
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef QUERYPARSER_H
+#define QUERYPARSER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Parsed boolean query. TERM holds one normalised term; PHRASE holds its
+// normalised words with their word offsets inside the phrase.
+struct QueryNode {
+    enum Type { TERM, PHRASE, AND, OR, NOT };
+    
+    Type type;
+    std::vector<std::string> terms;
+    std::vector<uint32_t> offsets; // PHRASE only
+    std::vector<QueryNode> children;
+    
+    explicit QueryNode(Type t) : type(t) {}
+};
+
+// Grammar (operators are upper case so ordinary words stay searchable):
+//   query   := andExpr ("OR" andExpr)*
+//   andExpr := unary (["AND"] unary)*      adjacent terms are ANDed
+//   unary   := "NOT" unary | primary
+//   primary := word | '"' words '"' | '(' query ')'
+// Words are normalised with the same Tokenizer rules used for indexing, and
+// words that normalise away (stop words, short words) are dropped.
+class QueryParser {
+private:
+    std::vector<std::string> tokens;
+    size_t pos;
+    
+    void lex(const std::string& query);
+    bool peek(const char* token) const;
+    bool parseQuery(QueryNode& node);
+    bool parseAnd(QueryNode& node);
+    bool parseUnary(QueryNode& node);
+    bool parsePrimary(QueryNode& node);
+    
+public:
+    QueryParser() : pos(0) {}
+    
+    // Returns false if nothing searchable is left in the query
+    bool parse(const std::string& query, QueryNode& root);
+};
+
+#endif
\ No newline at end of file
@@ -1,43 +1,217 @@
 #include "searchengine.h"
 #include <iostream>
 #include <algorithm>
+#include <iomanip>
+#include <chrono>
+#include <stdexcept>
 
-void SearchEngine::buildGraphFromSentences(const std::string& content) {
-    std::vector<std::string> sentences = Utils::splitIntoSentences(content);
-    
-    for (const auto& sentence : sentences) {
-        std::vector<std::string> keywords = Utils::tokenize(sentence);
+const int SearchEngine::PRUNE_WEIGHT;
+const size_t SearchEngine::BUDGET_CHECK_WORDS;
+
+static const char* const OVER_BUDGET = "Memory budget exceeded; upload rejected";
+
+SearchEngine::SearchEngine(const std::string& dataFile, const std::string& logFile)
+    : positionalIndexEnabled(true), dataPersistence(dataFile), loadFailed(false), stopping(false), memoryBudget(0),
+      overBudget(false), uncheckedWords(0), uploadLog(logFile), uploads([this](std::vector<AnalyzedDocument>& batch) { indexQueued(batch); }) {
+    compactor = std::thread(&SearchEngine::compactorLoop, this);
+}
+
+SearchEngine::~SearchEngine() {
+    uploads.shutdown(); // accepted uploads are still indexed
+    {
+        std::lock_guard<std::mutex> lock(compactorMutex);
+        stopping = true;
+    }
+    compactorWake.notify_all();
+    compactor.join();
+}
+
+void SearchEngine::compactorLoop() {
+    // Every commit or removal wakes the merger to check the segment tiers;
+    // postings of removed documents left below the merge thresholds are
+    // purged on the next quiet period
+    const std::chrono::seconds idle(30);
+    std::unique_lock<std::mutex> lock(compactorMutex);
+    while (!stopping) {
+        bool woken = compactorWake.wait_for(lock, idle) == std::cv_status::no_timeout;
+        if (stopping) {
+            break;
+        }
         
-        for (size_t i = 0; i < keywords.size(); ++i) {
-            topicGraph.addTopic(keywords[i]);
-            for (size_t j = i + 1; j < keywords.size(); ++j) {
-                topicGraph.incrementEdgeWeight(keywords[i], keywords[j]);
+        lock.unlock();
+        if (woken) {
+            mergeSegments(false);
+        } else {
+            size_t dead;
+            {
+                ReadGuard state(index);
+                dead = state->deadDocuments();
+            }
+            if (dead > 0) {
+                compactIndex();
             }
         }
+        if (overBudget) {
+            enforceMemoryBudget(); // removals only free their postings once merged
+        }
+        lock.lock();
     }
 }
 
-void SearchEngine::processKeywords(const std::vector<std::string>& keywords, const std::string& filename) {
-    for (const auto& keyword : keywords) {
-        if (keyword.length() > 2) {
-            trie.insert(keyword);
-            keywordIndex.addKeyword(keyword, filename);
+void SearchEngine::requestCompaction() {
+    compactorWake.notify_one();
+}
+
+void SearchEngine::freezeSegment() {
+    std::shared_ptr<const Segment> frozen;
+    index.write([&frozen](IndexState& state) {
+        state.freeze(frozen);
+    });
+}
+
+void SearchEngine::mergeSegments(bool purgeAll) {
+    // Merges are planned on a snapshot and built outside the writer lock;
+    // only swapping the result in goes through Versioned::write
+    std::lock_guard<std::mutex> lock(mergeMutex);
+    while (true) {
+        std::vector<std::shared_ptr<const Segment>> run;
+        std::vector<bool> live;
+        {
+            ReadGuard state(index);
+            if (!state->planMerge(purgeAll, run, live)) {
+                return;
+            }
         }
+        
+        std::shared_ptr<const Segment> merged = Segment::merge(run, live);
+        index.write([&run, &merged](IndexState& state) {
+            state.replaceSegments(run, merged);
+        });
     }
 }
 
+void SearchEngine::compactIndex() {
+    freezeSegment();
+    mergeSegments(true);
+}
+
+void SearchEngine::commitDocuments(const std::vector<AnalyzedDocument>& batch, ThreadPool* pool, uint64_t logged) {
+    // New uploads are logged and applied under one lock, so the log holds
+    // them in the order the index took them. The fsync comes after, shared
+    // with whoever else committed in the meantime.
+    bool positional = positionalIndexEnabled;
+    bool full = false;
+    {
+        std::unique_lock<std::mutex> lock(logMutex, std::defer_lock);
+        if (logged == 0) {
+            std::vector<WriteAheadLog::Record> records;
+            for (const auto& document : batch) {
+                if (document.error.empty()) {
+                    records.push_back(WriteAheadLog::Record(WriteAheadLog::Record::ADD, document.filename,
+                                                            document.content));
+                }
+            }
+            lock.lock();
+            logged = uploadLog.append(records);
+        }
+        index.write([&batch, positional, pool, logged, &full](IndexState& state) {
+            state.commit(batch, positional, pool);
+            state.markLogged(logged);
+            full = state.mutablePostings() >= IndexState::FREEZE_POSTINGS;
+        });
+    }
+    uploadLog.sync(logged);
+    if (full) {
+        freezeSegment();
+    }
+    
+    // Measuring usage walks every structure, so small commits only check
+    // the budget once enough words have gone in since the last check
+    size_t words = 0;
+    for (const auto& document : batch) {
+        words += document.length;
+    }
+    if (uncheckedWords.fetch_add(words) + words >= BUDGET_CHECK_WORDS) {
+        enforceMemoryBudget();
+    }
+    requestCompaction(); // merge new segments, or purge replaced versions
+}
+
+void SearchEngine::setMemoryBudget(size_t bytes) {
+    memoryBudget = bytes;
+    enforceMemoryBudget();
+}
+
+MemoryUsage SearchEngine::memoryUsage() const {
+    // Each copy of the index has its own dictionary, trie, graph, tables
+    // and mutable postings; segments, kept text and sentences are shared
+    ReadGuard state(index);
+    MemoryUsage usage = state->memoryUsage();
+    usage.trie *= 2;
+    usage.dictionary *= 2;
+    usage.postings *= 2;
+    usage.graph *= 2;
+    usage.positions *= 2;
+    usage.documents *= 2;
+    return usage;
+}
+
+void SearchEngine::enforceMemoryBudget() {
+    std::lock_guard<std::mutex> lock(budgetMutex);
+    uncheckedWords = 0;
+    size_t budget = memoryBudget;
+    size_t used = budget > 0 ? memoryUsage().total() : 0;
+    
+    // Kept text goes first. Its documents are then handled like streamed
+    // files: search and removal are unchanged, and snippets are read back
+    // from disk where the file still exists. The sentences kept in its
+    // place take some of the saving back, so this may take more than one
+    // round.
+    while (used > budget) {
+        std::vector<DocId> docs;
+        std::vector<IndexState::SentenceStream> streams;
+        {
+            ReadGuard state(index);
+            docs = state->planEviction(used - budget);
+            for (DocId doc : docs) {
+                streams.push_back(state->sentencesOf(doc));
+            }
+        }
+        if (docs.empty()) {
+            break;
+        }
+        index.write([&docs, &streams](IndexState& state) {
+            state.evictContent(docs, streams);
+        });
+        size_t remaining = memoryUsage().total();
+        bool freed = remaining < used;
+        used = remaining;
+        if (!freed) {
+            break;
+        }
+    }
+    
+    if (used > budget) {
+        index.write([](IndexState& state) {
+            state.topicGraph.pruneEdges(PRUNE_WEIGHT);
+        });
+        used = memoryUsage().total();
+    }
+    overBudget = used > budget;
+}
+
 void SearchEngine::uploadNote(const std::string& filename) {
     try {
-        std::string content = Utils::readFile(filename);
-        std::vector<std::string> keywords = Utils::tokenize(content);
-        
-        keywordIndex.storeFileContent(filename, content);
-        processKeywords(keywords, filename);
-        buildGraphFromSentences(content);
+        if (overBudget) {
+            throw std::runtime_error(OVER_BUDGET);
+        }
+        std::vector<AnalyzedDocument> batch(1);
+        batch[0].filename = filename;
+        DocumentAnalyzer::analyzeFile(batch[0], positionalIndexEnabled);
+        commitDocuments(batch, nullptr);
         
-        uploadedFiles.push_back(filename);
         std::cout << "\n[OK] Uploaded: " << filename << std::endl;
-        std::cout << "    Indexed " << keywords.size() << " keywords\n";
+        std::cout << "    Indexed " << batch[0].length << " keywords\n";
                   
     } catch (const std::exception& e) {
         std::cout << "\n[ERROR] " << e.what() << std::endl;
@@ -46,89 +220,502 @@ void SearchEngine::uploadNote(const std::string& filename) {
 
 void SearchEngine::uploadFile(const std::string& filename, const std::string& content) {
     try {
-        std::vector<std::string> keywords = Utils::tokenize(content);
-        
-        keywordIndex.storeFileContent(filename, content);
-        processKeywords(keywords, filename);
-        buildGraphFromSentences(content);
+        if (overBudget) {
+            throw std::runtime_error(OVER_BUDGET);
+        }
+        std::vector<AnalyzedDocument> batch(1);
+        batch[0].filename = filename;
+        batch[0].content = std::make_shared<std::string>(content);
+        DocumentAnalyzer::analyze(batch[0], positionalIndexEnabled);
+        commitDocuments(batch, nullptr);
         
-        uploadedFiles.push_back(filename);
         std::cout << "\n[OK] Uploaded: " << filename << std::endl;
-        std::cout << "    Indexed " << keywords.size() << " keywords\n";
+        std::cout << "    Indexed " << batch[0].length << " keywords\n";
                   
     } catch (const std::exception& e) {
         std::cout << "\n[ERROR] " << e.what() << std::endl;
     }
 }
 
-std::vector<FileInfo> SearchEngine::search(const std::string& keyword) {
-    std::vector<FileInfo> files = keywordIndex.getFiles(keyword);
+JobId SearchEngine::queueUpload(const std::string& filename, const std::string& content) {
+    if (overBudget) {
+        return INVALID_JOB;
+    }
+    return uploads.submit(filename, std::make_shared<std::string>(content));
+}
+
+UploadStatus SearchEngine::uploadStatus(JobId job) const {
+    return uploads.status(job);
+}
+
+void SearchEngine::indexQueued(std::vector<AnalyzedDocument>& batch) {
+    // Runs on the upload queue's thread; the whole batch is one commit.
+    // Jobs accepted before the index went over budget are refused here.
+    bool positional = positionalIndexEnabled;
+    bool rejected = overBudget;
+    for (auto& document : batch) {
+        if (rejected) {
+            document.error = OVER_BUDGET;
+            continue;
+        }
+        try {
+            if (document.content) {
+                DocumentAnalyzer::analyze(document, positional);
+            } else {
+                DocumentAnalyzer::analyzeFile(document, positional);
+            }
+        } catch (const std::exception& e) {
+            document.error = e.what();
+        }
+    }
+    if (!rejected) {
+        commitDocuments(batch, nullptr);
+    }
+}
+
+void SearchEngine::uploadNotes(const std::vector<std::string>& filenames, size_t threads) {
+    std::vector<std::string> indexed;
+    size_t keywordCount = ingestFiles(filenames, threads, indexed);
     
-    // Sort by frequency
-    std::sort(files.begin(), files.end(),
-              [](const FileInfo& a, const FileInfo& b) {
-                  return a.frequency > b.frequency;
-              });
+    std::cout << "\n[OK] Uploaded " << indexed.size() << " of " << filenames.size() << " files" << std::endl;
+    std::cout << "    Indexed " << keywordCount << " keywords\n";
+}
+
+size_t SearchEngine::ingestFiles(const std::vector<std::string>& filenames, size_t threads,
+                                 std::vector<std::string>& indexed) {
+    // Files are read and tokenized in parallel a batch at a time, then each
+    // batch is merged in input order; the result is identical to uploading
+    // the files one by one
+    const size_t batchSize = 256;
+    ThreadPool pool(threads);
+    bool positional = positionalIndexEnabled;
+    size_t keywordCount = 0;
     
-    return files;
+    for (size_t first = 0; first < filenames.size(); first += batchSize) {
+        size_t last = std::min(filenames.size(), first + batchSize);
+        std::vector<AnalyzedDocument> batch(last - first);
+        bool rejected = overBudget;
+        
+        for (size_t i = 0; i < batch.size(); ++i) {
+            AnalyzedDocument* document = &batch[i];
+            document->filename = filenames[first + i];
+            if (rejected) {
+                document->error = OVER_BUDGET;
+                continue;
+            }
+            pool.submit([document, positional] {
+                try {
+                    DocumentAnalyzer::analyzeFile(*document, positional);
+                } catch (const std::exception& e) {
+                    document->error = e.what();
+                }
+            });
+        }
+        pool.wait();
+        
+        if (!rejected) {
+            try {
+                commitDocuments(batch, &pool);
+            } catch (const std::exception& e) {
+                for (auto& document : batch) {
+                    if (document.error.empty()) {
+                        document.error = e.what();
+                    }
+                }
+            }
+        }
+        
+        for (const auto& document : batch) {
+            if (document.error.empty()) {
+                indexed.push_back(document.filename);
+                keywordCount += document.length;
+            } else {
+                std::cout << "\n[ERROR] " << document.error << std::endl;
+            }
+        }
+    }
+    
+    return keywordCount;
+}
+
+size_t SearchEngine::removeFiles(const std::vector<std::string>& filenames, uint64_t logged) {
+    // Logged like uploads; a filename that is not indexed costs a record
+    // but changes nothing on replay
+    size_t removed = 0;
+    {
+        std::unique_lock<std::mutex> lock(logMutex, std::defer_lock);
+        if (logged == 0) {
+            std::vector<WriteAheadLog::Record> records;
+            for (const auto& filename : filenames) {
+                records.push_back(WriteAheadLog::Record(WriteAheadLog::Record::REMOVE, filename));
+            }
+            lock.lock();
+            logged = uploadLog.append(records);
+        }
+        index.write([&filenames, logged, &removed](IndexState& state) {
+            removed = 0;
+            for (const auto& filename : filenames) {
+                DocId doc = state.documents.find(filename);
+                if (doc != INVALID_DOC) {
+                    state.removeDocument(doc);
+                    ++removed;
+                }
+            }
+            state.markLogged(logged);
+        });
+    }
+    uploadLog.sync(logged);
+    
+    if (removed > 0) {
+        requestCompaction();
+    }
+    return removed;
+}
+
+void SearchEngine::removeNote(const std::string& filename) {
+    try {
+        if (removeFiles(std::vector<std::string>(1, filename)) > 0) {
+            std::cout << "\n[OK] Removed: " << filename << std::endl;
+        } else {
+            std::cout << "\n[INFO] Not indexed: " << filename << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cout << "\n[ERROR] " << e.what() << std::endl;
+    }
+}
+
+void SearchEngine::syncDirectory(const std::string& directory, size_t threads) {
+    std::lock_guard<std::mutex> lock(syncMutex);
+    DirectorySync::Changes changes;
+    try {
+        changes = directorySync.scan(directory);
+    } catch (const std::exception& e) {
+        std::cout << "\n[ERROR] " << e.what() << std::endl;
+        return;
+    }
+    
+    if (!changes.removed.empty()) {
+        try {
+            removeFiles(changes.removed);
+        } catch (const std::exception& e) {
+            std::cout << "\n[ERROR] " << e.what() << std::endl;
+            return;
+        }
+        for (const auto& filename : changes.removed) {
+            directorySync.markRemoved(filename);
+        }
+    }
+    
+    // Modified files replace their earlier version when committed
+    std::vector<std::string> files(changes.added);
+    files.insert(files.end(), changes.modified.begin(), changes.modified.end());
+    std::vector<std::string> indexed;
+    ingestFiles(files, threads, indexed);
+    for (const auto& filename : indexed) {
+        directorySync.markIndexed(filename);
+    }
+    
+    std::cout << "\n[OK] Synced " << directory << ": " << changes.added.size() << " added, "
+              << changes.modified.size() << " updated, " << changes.removed.size() << " removed, "
+              << changes.unchanged << " unchanged" << std::endl;
+}
+
+std::vector<SearchResult> SearchEngine::resolveResults(const IndexState& state, TopKHeap& top) const {
+    // Filenames are only looked up for the results that made the cut
+    std::vector<SearchResult> results = top.getSorted();
+    for (auto& result : results) {
+        result.filename = state.documents.getFilename(result.docId);
+    }
+    return results;
+}
+
+static void collectTerms(const QueryNode& node, std::vector<std::string>& terms) {
+    // Terms under NOT only filter; they never add to a document's score
+    if (node.type == QueryNode::NOT) {
+        return;
+    }
+    for (const auto& term : node.terms) {
+        terms.push_back(term);
+    }
+    for (const auto& child : node.children) {
+        collectTerms(child, terms);
+    }
+}
+
+static bool isTermDisjunction(const QueryNode& node) {
+    if (node.type == QueryNode::TERM) {
+        return true;
+    }
+    if (node.type != QueryNode::OR) {
+        return false;
+    }
+    for (const auto& child : node.children) {
+        if (child.type != QueryNode::TERM) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<SearchResult> SearchEngine::search(const std::string& query, size_t maxResults) {
+    ReadGuard state(index);
+    return evaluateQuery(*state, query, maxResults);
+}
+
+std::vector<SearchResult> SearchEngine::evaluateQuery(const IndexState& state, const std::string& query,
+                                                      size_t maxResults) const {
+    QueryParser parser;
+    QueryNode root(QueryNode::AND);
+    if (!parser.parse(query, root)) {
+        return {};
+    }
+    
+    std::vector<std::string> terms;
+    collectTerms(root, terms);
+    
+    // Plain term disjunctions never need their matches materialised
+    if (isTermDisjunction(root)) {
+        return rankAnyTerm(state, terms, maxResults);
+    }
+    
+    // Score the matches by BM25 over the positive query terms, with idf
+    // taken over all segments
+    BM25Scorer scorer = state.makeScorer();
+    std::vector<TermId> ids;
+    std::vector<double> idfs;
+    for (const auto& term : terms) {
+        TermId id = state.termDictionary.find(term);
+        size_t frequency = state.documentFrequency(id);
+        if (frequency > 0 && std::find(ids.begin(), ids.end(), id) == ids.end()) {
+            ids.push_back(id);
+            idfs.push_back(scorer.idf(frequency));
+        }
+    }
+    
+    // Each segment is evaluated on its own; they cover disjoint documents
+    TopKHeap top(maxResults);
+    for (const auto& segment : state.segmentViews()) {
+        QueryEvaluator evaluator = state.makeEvaluator(segment, positionalIndexEnabled);
+        std::vector<DocId> matches = evaluator.evaluate(root);
+        if (matches.empty()) {
+            continue;
+        }
+        
+        std::vector<PostingList::Iterator> lists;
+        std::vector<double> listIdfs;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            const PostingList* list = segment.postings->getPostings(ids[i]);
+            if (list != nullptr) {
+                lists.push_back(list->iterator());
+                listIdfs.push_back(idfs[i]);
+            }
+        }
+        
+        for (DocId doc : matches) {
+            double score = 0.0;
+            uint32_t frequency = 0;
+            for (size_t i = 0; i < lists.size(); ++i) {
+                lists[i].advance(doc);
+                if (lists[i].valid() && lists[i].docId() == doc) {
+                    score += scorer.score(listIdfs[i], lists[i].frequency(), state.documents.getLength(doc));
+                    frequency += lists[i].frequency();
+                }
+            }
+            top.offer(SearchResult(doc, frequency, score));
+        }
+    }
+    
+    return resolveResults(state, top);
+}
+
+std::vector<SearchResult> SearchEngine::rankAnyTerm(const IndexState& state, const std::vector<std::string>& terms,
+                                                    size_t maxResults) const {
+    // Ranked disjunction: a document matching any query term is a candidate,
+    // and block-max WAND skips the ones that cannot reach the top k
+    BM25Scorer scorer = state.makeScorer();
+    std::vector<TermId> ids;
+    std::vector<double> idfs;
+    for (const auto& term : terms) {
+        TermId id = state.termDictionary.find(term);
+        size_t frequency = state.documentFrequency(id);
+        if (frequency > 0 && std::find(ids.begin(), ids.end(), id) == ids.end()) {
+            ids.push_back(id);
+            idfs.push_back(scorer.idf(frequency));
+        }
+    }
+    
+    // Segments share one heap, so the threshold reached in one lets WAND
+    // skip more of the next
+    TopKHeap top(maxResults);
+    for (const auto& segment : state.segmentViews()) {
+        WandEvaluator evaluator(scorer, state.documents);
+        for (size_t i = 0; i < ids.size(); ++i) {
+            const PostingList* postings = segment.postings->getPostings(ids[i]);
+            if (postings != nullptr) {
+                evaluator.addTerm(*postings, idfs[i]);
+            }
+        }
+        evaluator.evaluate(top);
+    }
+    return resolveResults(state, top);
+}
+
+std::vector<SearchResult> SearchEngine::searchTerms(const std::string& query, size_t maxResults) {
+    ReadGuard state(index);
+    return rankAnyTerm(*state, Utils::tokenize(query), maxResults);
+}
+
+std::vector<SearchResult> SearchEngine::searchPhrase(const std::string& phrase, size_t maxResults) {
+    ReadGuard state(index);
+    std::vector<std::pair<TermId, uint32_t>> words; // term, position in the phrase
+    Tokenizer tokenizer(phrase);
+    while (tokenizer.next()) {
+        words.push_back({state->termDictionary.find(tokenizer.term()), static_cast<uint32_t>(tokenizer.position())});
+    }
+    if (words.empty()) {
+        return {};
+    }
+    
+    std::vector<Posting> matches;
+    for (const auto& segment : state->segmentViews()) {
+        std::vector<Posting> found = state->makeEvaluator(segment, positionalIndexEnabled).matchPhrase(words);
+        matches.insert(matches.end(), found.begin(), found.end());
+    }
+    
+    // The phrase is scored as a single pseudo-term
+    BM25Scorer scorer = state->makeScorer();
+    double idf = scorer.idf(matches.size());
+    TopKHeap top(maxResults);
+    for (const auto& match : matches) {
+        double score = scorer.score(idf, match.frequency, state->documents.getLength(match.docId));
+        top.offer(SearchResult(match.docId, match.frequency, score));
+    }
+    
+    return resolveResults(*state, top);
 }
 
 std::vector<std::pair<std::string, int>> SearchEngine::getRelatedTopics(const std::string& topic) {
-    return topicGraph.getRelatedTopics(topic);
+    ReadGuard state(index);
+    return relatedTopics(*state, topic);
+}
+
+std::vector<std::pair<std::string, int>> SearchEngine::relatedTopics(const IndexState& state,
+                                                                     const std::string& topic) const {
+    std::vector<std::pair<std::string, int>> related;
+    TermId id = state.termDictionary.find(topic);
+    if (id == INVALID_TERM) {
+        return related;
+    }
+    
+    for (const auto& rel : state.topicGraph.getRelatedTopics(id)) {
+        related.push_back({state.termDictionary.getTerm(rel.first), rel.second});
+    }
+    return related;
 }
 
 std::vector<std::string> SearchEngine::getLearningPath(const std::string& topic) {
-    if (!topicGraph.containsTopic(topic)) {
-        return {};
+    ReadGuard state(index);
+    return learningPath(*state, topic);
+}
+
+std::vector<std::string> SearchEngine::learningPath(const IndexState& state, const std::string& topic) const {
+    std::vector<std::string> path;
+    TermId id = state.termDictionary.find(topic);
+    if (id == INVALID_TERM || !state.topicGraph.containsTopic(id)) {
+        return path;
     }
     
-    return topicGraph.getLearningPath(topic, 8);
+    for (TermId step : state.topicGraph.getLearningPath(id, 8)) {
+        path.push_back(state.termDictionary.getTerm(step));
+    }
+    return path;
 }
 
 std::string SearchEngine::getSnippet(const std::string& filename, const std::string& keyword) {
-    if (!keywordIndex.hasFileContent(filename)) {
-        return "File content not available";
+    ReadGuard state(index);
+    DocId doc = state->documents.find(filename);
+    std::string snippet;
+    if (doc != INVALID_DOC) {
+        snippet = snippetFor(*state, doc, keyword);
+    }
+    return snippet.empty() ? "File content not available" : snippet;
+}
+
+std::string SearchEngine::snippetFor(const IndexState& state, DocId doc, const std::string& keyword) const {
+    const CompressedText& content = state.keywordIndex.getFileContent(doc);
+    bool kept = state.keywordIndex.hasFileContent(doc);
+    
+    // With positions the snippet starts at the earliest hit of any query
+    // term instead of rescanning the whole document for it
+    if (positionalIndexEnabled) {
+        const Occurrence* first = nullptr;
+        Tokenizer tokenizer(keyword);
+        while (tokenizer.next()) {
+            PositionIndex::Range hits = state.positions.find(doc, state.termDictionary.find(tokenizer.term()));
+            if (hits.first != hits.second && (first == nullptr || hits.first->offset < first->offset)) {
+                first = hits.first;
+            }
+        }
+        if (first != nullptr) {
+            // Only a window around the hit is needed, starting on a word
+            // boundary: the blocks holding it if the text is kept, else read
+            // from disk for text too large to keep in memory
+            const size_t margin = 1024;
+            size_t start = first->offset > margin ? first->offset - margin : 0;
+            std::string window = kept ? content.range(start, 2 * margin)
+                                      : Utils::readRange(state.documents.getFilename(doc), start, 2 * margin);
+            size_t skip = 0;
+            if (start > 0) {
+                skip = std::min(window.find_first_of(" \t\r\n"), first->offset - start);
+            }
+            if (first->offset - start < window.size()) {
+                return Utils::extractSnippetAt(window.substr(skip), first->offset - start - skip, 8);
+            }
+        }
     }
     
-    std::string content = keywordIndex.getFileContent(filename);
-    return Utils::extractSnippet(content, keyword, 8);
+    if (!kept) {
+        return std::string();
+    }
+    return Utils::extractSnippet(content.text(), keyword, 8);
 }
 
 std::vector<std::string> SearchEngine::getUploadedFiles() {
-    return uploadedFiles;
+    ReadGuard state(index);
+    std::vector<std::string> files;
+    for (DocId doc = 0; doc < state->documents.size(); ++doc) {
+        if (state->documents.isLive(doc)) {
+            files.push_back(state->documents.getFilename(doc));
+        }
+    }
+    return files;
 }
 
 void SearchEngine::searchAndDisplay(const std::string& keyword) {
-    // Get search results
-    std::vector<FileInfo> files = keywordIndex.getFiles(keyword);
+    // Results, snippet and related topics all come from the same snapshot
+    ReadGuard state(index);
+    std::vector<SearchResult> files = evaluateQuery(*state, keyword, 10);
     
     if (!files.empty()) {
-        // Sort by frequency
-        std::sort(files.begin(), files.end(), 
-                  [](const FileInfo& a, const FileInfo& b) { 
-                      return a.frequency > b.frequency; 
-                  });
-        
         std::cout << "\n=== Search Results: " << keyword << " ===\n";
         
         // Show top 5 results
         int limit = std::min(5, (int)files.size());
         for (int i = 0; i < limit; ++i) {
             std::cout << i + 1 << ". " << files[i].filename 
-                      << " (" << files[i].frequency << " mentions)\n";
+                      << " (" << files[i].frequency << " mentions, score "
+                      << std::fixed << std::setprecision(2) << files[i].relevance << ")\n";
         }
         
         // Show snippet from top result
-        if (!files.empty() && keywordIndex.hasFileContent(files[0].filename)) {
-            std::string content = keywordIndex.getFileContent(files[0].filename);
-            std::string snippet = Utils::extractSnippet(content, keyword, 8);
-            
+        std::string snippet = snippetFor(*state, files[0].docId, keyword);
+        if (!snippet.empty()) {
             std::cout << "\n--- Snippet from " << files[0].filename << " ---\n" 
                       << snippet << "\n";
         }
         
         // Show related topics
-        auto related = topicGraph.getRelatedTopics(keyword);
+        auto related = relatedTopics(*state, keyword);
         if (!related.empty()) {
             std::cout << "\n--- Related topics ---\n";
             for (size_t i = 0; i < related.size(); ++i) {
@@ -143,12 +730,15 @@ void SearchEngine::searchAndDisplay(const std::string& keyword) {
 }
 
 void SearchEngine::displayLearningPath(const std::string& topic) {
-    if (!topicGraph.containsTopic(topic)) {
+    ReadGuard state(index);
+    TermId id = state->termDictionary.find(topic);
+    if (id == INVALID_TERM || !state->topicGraph.containsTopic(id)) {
         std::cout << "\n[INFO] Topic not found. Upload notes first.\n";
         return;
     }
     
-    auto path = topicGraph.getLearningPath(topic, 8);
+    // The path comes from the snapshot the topic was found in
+    auto path = learningPath(*state, topic);
     
     if (path.empty() || path.size() < 3) {
         std::cout << "\n[INFO] Insufficient connections to build learning path.\n";
@@ -165,7 +755,9 @@ void SearchEngine::displayLearningPath(const std::string& topic) {
 }
 
 void SearchEngine::displayMindMap(const std::string& topic) {
-    if (!topicGraph.containsTopic(topic)) {
+    ReadGuard state(index);
+    TermId id = state->termDictionary.find(topic);
+    if (id == INVALID_TERM || !state->topicGraph.containsTopic(id)) {
         std::cout << "\n[INFO] Topic not found. Upload notes first.\n";
         return;
     }
@@ -173,7 +765,7 @@ void SearchEngine::displayMindMap(const std::string& topic) {
     std::cout << "\n=== Mind Map: " << topic << " ===\n";
     
     // Simple indented display
-    auto related = topicGraph.getRelatedTopics(topic, 1);
+    auto related = state->topicGraph.getRelatedTopics(id, 1);
     
     if (related.empty()) {
         std::cout << topic << "\n";
@@ -183,8 +775,35 @@ void SearchEngine::displayMindMap(const std::string& topic) {
     
     std::cout << topic << "\n";
     for (const auto& rel : related) {
-        std::cout << "  |- " << rel.first << " [weight: " << rel.second << "]\n";
+        std::cout << "  |- " << state->termDictionary.getTerm(rel.first) << " [weight: " << rel.second << "]\n";
+    }
+}
+
+void SearchEngine::displayMemoryUsage() {
+    MemoryUsage usage = memoryUsage();
+    size_t budget = memoryBudget;
+    const double mb = 1024.0 * 1024.0;
+    
+    std::cout << "\n=== Memory Usage ===\n" << std::fixed << std::setprecision(1);
+    std::cout << "Trie:           " << usage.trie / mb << " MB\n";
+    std::cout << "Dictionary:     " << usage.dictionary / mb << " MB\n";
+    std::cout << "Postings:       " << (usage.postings + usage.segments) / mb << " MB\n";
+    std::cout << "Stored content: " << usage.contents / mb << " MB\n";
+    std::cout << "Sentences:      " << usage.sentences / mb << " MB\n";
+    std::cout << "Topic graph:    " << usage.graph / mb << " MB\n";
+    std::cout << "Positions:      " << usage.positions / mb << " MB\n";
+    std::cout << "Documents:      " << usage.documents / mb << " MB\n";
+    if (usage.mapped > 0) {
+        std::cout << "Mapped file:    " << usage.mapped / mb << " MB (shared page cache, not in total)\n";
+    }
+    std::cout << "Total:          " << usage.total() / mb << " MB";
+    if (budget > 0) {
+        std::cout << " of " << budget / mb << " MB budget";
+        if (overBudget) {
+            std::cout << " (uploads refused)";
+        }
     }
+    std::cout << "\n";
 }
 
 void SearchEngine::displayMenu() {
@@ -195,17 +814,139 @@ void SearchEngine::displayMenu() {
     std::cout << "2. Search topic\n";
     std::cout << "3. Generate learning path\n";
     std::cout << "4. View mind map\n";
-    std::cout << "5. Save & Exit\n";
+    std::cout << "5. Sync notes folder\n";
+    std::cout << "6. Memory usage\n";
+    std::cout << "7. Save & Exit\n";
     std::cout << "=====================================\n";
     std::cout << "Choice: ";
 }
 
+void SearchEngine::setPositionalIndexEnabled(bool enabled) {
+    // Only affects documents indexed from now on
+    positionalIndexEnabled = enabled;
+}
+
 void SearchEngine::saveData() {
-    dataPersistence.saveData(trie, topicGraph, keywordIndex);
+    // The log position is read with the snapshot pinned and no commit in
+    // flight, so everything before it is in the save and can be dropped.
+    // Closing the epoch first lets the save skip parts its last one holds.
+    std::lock_guard<std::mutex> lock(syncMutex);
+    if (loadFailed) {
+        std::cout << "Error: Not saving, since the index already saved could not be loaded. "
+                  << "Move it aside to start a new one.\n";
+        return;
+    }
+    uint64_t epoch = 0;
+    index.write([&epoch](IndexState& state) {
+        epoch = state.beginCheckpoint();
+    });
+    std::unique_lock<std::mutex> logLock(logMutex);
+    ReadGuard state(index);
+    uint64_t logged = uploadLog.position();
+    logLock.unlock();
+    
+    if (dataPersistence.saveData(*state, directorySync, epoch)) {
+        try {
+            uploadLog.discardBefore(logged);
+        } catch (const std::exception& e) {
+            std::cout << "Warning: Could not trim the upload log: " << e.what() << std::endl;
+        }
+    }
+}
+
+size_t SearchEngine::replayLog(uint64_t after) {
+    // Logged uploads are analysed again in parallel a batch at a time, as
+    // bulk ingestion does, and committed under the sequence they were
+    // logged with. Text that was not kept is read back from the file.
+    const size_t batchSize = 256;
+    std::lock_guard<std::mutex> lock(logMutex);
+    ThreadPool pool(0);
+    bool positional = positionalIndexEnabled;
+    std::vector<AnalyzedDocument> batch;
+    uint64_t batchEnd = 0;
+    size_t replayed = 0;
+    
+    auto commitBatch = [&]() {
+        for (auto& document : batch) {
+            AnalyzedDocument* target = &document;
+            pool.submit([target, positional] {
+                try {
+                    if (target->content) {
+                        DocumentAnalyzer::analyze(*target, positional);
+                    } else {
+                        DocumentAnalyzer::analyzeFile(*target, positional);
+                    }
+                } catch (const std::exception& e) {
+                    target->error = e.what();
+                }
+            });
+        }
+        pool.wait();
+        for (const auto& document : batch) {
+            if (!document.error.empty()) {
+                std::cout << "\n[ERROR] " << document.error << std::endl;
+            }
+        }
+        commitDocuments(batch, &pool, batchEnd);
+        replayed += batch.size();
+        batch.clear();
+    };
+    
+    uploadLog.replay(after, [&](const WriteAheadLog::Record& record) {
+        if (record.type == WriteAheadLog::Record::REMOVE) {
+            if (!batch.empty()) {
+                commitBatch();
+            }
+            removeFiles(std::vector<std::string>(1, record.filename), record.sequence);
+            ++replayed;
+            return;
+        }
+        batch.push_back(AnalyzedDocument());
+        batch.back().filename = record.filename;
+        batch.back().content = record.content;
+        batchEnd = record.sequence;
+        if (batch.size() >= batchSize) {
+            commitBatch();
+        }
+    });
+    if (!batch.empty()) {
+        commitBatch();
+    }
+    return replayed;
 }
 
 void SearchEngine::loadData() {
-    if (!dataPersistence.loadData(trie, topicGraph, keywordIndex)) {
+    // Parsed outside the index lock; restore() then only moves it into place
+    IndexState::Image image;
+    DataPersistence::LoadResult loaded;
+    {
+        std::lock_guard<std::mutex> lock(syncMutex);
+        loaded = dataPersistence.loadData(image, directorySync);
+        loadFailed = loaded == DataPersistence::FAILED;
+    }
+    if (loaded == DataPersistence::FAILED) {
+        // Earlier saves trimmed the log, so replaying it over an empty index
+        // would bring back only the latest changes
+        std::cout << "Error: The saved index could not be loaded; the upload log was not replayed "
+                  << "and will be kept. Starting with an empty index.\n";
+        return;
+    }
+    if (loaded == DataPersistence::LOADED) {
+        index.write([&image](IndexState& state) {
+            state.restore(image);
+        });
+    }
+    
+    // Whatever was uploaded or removed after the save goes back on top
+    size_t replayed = 0;
+    try {
+        replayed = replayLog(image.logSequence);
+    } catch (const std::exception& e) {
+        std::cout << "Warning: Could not replay the upload log: " << e.what() << std::endl;
+    }
+    if (replayed > 0) {
+        std::cout << "Replayed " << replayed << " logged changes\n";
+    } else if (loaded == DataPersistence::NOT_FOUND) {
         std::cout << "No saved data found.\n";
     }
 }
@@ -251,13 +992,22 @@ void SearchEngine::run() {
                 displayMindMap(input);
                 break;
             }
-            case 5:
+            case 5: {
+                std::cout << "\nFolder path: ";
+                std::getline(std::cin, input);
+                syncDirectory(input);
+                break;
+            }
+            case 6:
+                displayMemoryUsage();
+                break;
+            case 7:
                 std::cout << "\nSaving data...\n";
                 saveData();
                 std::cout << "Goodbye!\n";
                 return;
             default:
-                std::cout << "\n[ERROR] Invalid choice. Please enter 1-5.\n";
+                std::cout << "\n[ERROR] Invalid choice. Please enter 1-7.\n";
         }
         std::cout << std::endl;
     }
@@ -4,30 +4,107 @@
 #include <string>
 #include <vector>
 #include <algorithm>
-#include "trie.h"
-#include "graph.h"
-#include "hashmap.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "indexstate.h"
+#include "versioned.h"
 #include "heap.h"
+#include "bm25.h"
+#include "wand.h"
+#include "queryparser.h"
+#include "queryevaluator.h"
+#include "documentanalyzer.h"
+#include "threadpool.h"
+#include "uploadqueue.h"
 #include "utils.h"
 #include "datapersistence.h"
+#include "writeaheadlog.h"
+#include "directorysync.h"
 
+// Queries read a published IndexState and never take a lock; uploads are
+// serialised among themselves and applied through Versioned::write. Queued
+// uploads are indexed in batches by the upload queue's thread, and another
+// background thread merges index segments, purging removed documents.
+//
+// With a memory budget set, going over it first gives up kept text, oldest
+// document first, then prunes edges lighter than PRUNE_WEIGHT; if the index
+// is still too large, uploads are refused until removals shrink it.
+//
+// Every upload and removal is written to the write-ahead log before it is
+// acknowledged; loadData() replays the log on top of the saved index, and
+// saveData() drops the part of the log the save now holds. If a saved index
+// exists but cannot be read, the log is neither replayed nor trimmed and
+// nothing is saved over the index, since the log alone no longer holds
+// what the save did.
 class SearchEngine {
+public:
+    static const int PRUNE_WEIGHT = 2;
+    static const size_t BUDGET_CHECK_WORDS = 1 << 16; // indexed between two checks after commits
+    
 private:
-    Trie trie;
-    Graph topicGraph;
-    HashMap keywordIndex;
-    std::vector<std::string> uploadedFiles;
+    typedef Versioned<IndexState>::ReadGuard ReadGuard;
+    
+    Versioned<IndexState> index;
+    std::atomic<bool> positionalIndexEnabled;
     DataPersistence dataPersistence;
+    DirectorySync directorySync;
+    std::mutex syncMutex;
+    bool loadFailed; // the saved index could not be read; guarded by syncMutex
+    std::thread compactor;
+    std::mutex compactorMutex;
+    std::condition_variable compactorWake;
+    bool stopping;
+    std::mutex mergeMutex;
+    std::atomic<size_t> memoryBudget; // bytes, 0 for none
+    std::atomic<bool> overBudget;
+    std::atomic<size_t> uncheckedWords;
+    std::mutex budgetMutex;
+    WriteAheadLog uploadLog;
+    std::mutex logMutex; // log order is commit order
+    UploadQueue uploads; // declared last: its thread commits into everything above
 
-    void processKeywords(const std::vector<std::string>& keywords, const std::string& filename);
-    void buildGraphFromSentences(const std::string& content);
+    // A batch replayed from the log passes the sequence it was logged under
+    void commitDocuments(const std::vector<AnalyzedDocument>& batch, ThreadPool* pool, uint64_t logged = 0);
+    size_t removeFiles(const std::vector<std::string>& filenames, uint64_t logged = 0);
+    size_t replayLog(uint64_t after);
+    void indexQueued(std::vector<AnalyzedDocument>& batch);
+    void compactorLoop();
+    void requestCompaction();
+    void freezeSegment();
+    void mergeSegments(bool purgeAll);
+    void enforceMemoryBudget();
+    size_t ingestFiles(const std::vector<std::string>& filenames, size_t threads, std::vector<std::string>& indexed);
+    std::string snippetFor(const IndexState& state, DocId doc, const std::string& keyword) const;
+    std::vector<SearchResult> resolveResults(const IndexState& state, TopKHeap& top) const;
+    std::vector<SearchResult> evaluateQuery(const IndexState& state, const std::string& query, size_t maxResults) const;
+    std::vector<SearchResult> rankAnyTerm(const IndexState& state, const std::vector<std::string>& terms, size_t maxResults) const;
+    std::vector<std::pair<std::string, int>> relatedTopics(const IndexState& state, const std::string& topic) const;
+    std::vector<std::string> learningPath(const IndexState& state, const std::string& topic) const;
 
 public:
-    SearchEngine() : dataPersistence("search_data.dat") {}
+    // Engines sharing a directory need paths of their own: each owns its
+    // log, and two writing one log would interleave their records. An
+    // empty log path turns logging off.
+    explicit SearchEngine(const std::string& dataFile = "search_data.dat",
+                          const std::string& logFile = "search_data.wal");
+    ~SearchEngine();
 
     void uploadNote(const std::string& filename);
     void uploadFile(const std::string& filename, const std::string& content);
-    std::vector<FileInfo> search(const std::string& keyword);
+    void uploadNotes(const std::vector<std::string>& filenames, size_t threads = 0);
+    // INVALID_JOB if the queue is full or the index is over its memory budget
+    JobId queueUpload(const std::string& filename, const std::string& content);
+    UploadStatus uploadStatus(JobId job) const;
+    void removeNote(const std::string& filename);
+    void syncDirectory(const std::string& directory, size_t threads = 0);
+    void compactIndex();
+    void setMemoryBudget(size_t bytes); // 0 lifts the budget
+    MemoryUsage memoryUsage() const;    // both copies of the index, shared parts once
+    std::vector<SearchResult> search(const std::string& query, size_t maxResults = 10);
+    std::vector<SearchResult> searchTerms(const std::string& query, size_t maxResults = 10);
+    std::vector<SearchResult> searchPhrase(const std::string& phrase, size_t maxResults = 10);
     std::vector<std::pair<std::string, int>> getRelatedTopics(const std::string& topic);
     std::vector<std::string> getLearningPath(const std::string& topic);
     std::string getSnippet(const std::string& filename, const std::string& keyword);
@@ -35,8 +112,10 @@ public:
     void searchAndDisplay(const std::string& keyword);
     void displayLearningPath(const std::string& topic);
     void displayMindMap(const std::string& topic);
+    void displayMemoryUsage();
     void displayMenu();
     void run();
+    void setPositionalIndexEnabled(bool enabled);
     void saveData();
     void loadData();
 };
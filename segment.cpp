@@ -0,0 +1,71 @@
+#include "segment.h"
+#include <algorithm>
+
+Segment::Segment(DocId firstDoc, DocId endDoc, std::vector<TermId>&& termIds,
+                 std::vector<PostingList>&& termPostings, size_t live, const std::shared_ptr<const MappedFile>& mapping)
+    : first(firstDoc), end(endDoc), terms(std::move(termIds)), postings(std::move(termPostings)), postingTotal(0),
+      liveDocuments(live), bytes(sizeof(*this)), file(mapping) {
+    terms.shrink_to_fit();
+    postings.shrink_to_fit();
+    bytes += terms.capacity() * sizeof(TermId);
+    for (auto& list : postings) {
+        list.shrink();
+        postingTotal += list.size();
+        bytes += list.byteSize();
+    }
+}
+
+std::shared_ptr<const Segment> Segment::merge(const std::vector<std::shared_ptr<const Segment>>& run,
+                                              const std::vector<bool>& live) {
+    DocId firstDoc = run.front()->firstDoc();
+    DocId endDoc = run.back()->endDoc();
+
+    // Every input's terms are sorted, so a cursor per input walks them
+    // together and each term of the run comes up once, in order. The run
+    // is in DocId order, so appending each input's list in turn keeps
+    // every merged list sorted.
+    std::vector<size_t> cursors(run.size(), 0);
+    std::vector<TermId> terms;
+    std::vector<PostingList> merged;
+    while (true) {
+        TermId keyword = INVALID_TERM;
+        for (size_t i = 0; i < run.size(); ++i) {
+            if (cursors[i] < run[i]->terms.size()) {
+                keyword = std::min(keyword, run[i]->terms[cursors[i]]);
+            }
+        }
+        if (keyword == INVALID_TERM) {
+            break;
+        }
+
+        PostingList list;
+        for (size_t i = 0; i < run.size(); ++i) {
+            const Segment& segment = *run[i];
+            if (cursors[i] == segment.terms.size() || segment.terms[cursors[i]] != keyword) {
+                continue;
+            }
+            const PostingList& input = segment.postings[cursors[i]++];
+            for (PostingList::Iterator it = input.iterator(); it.valid(); it.next()) {
+                if (live[it.docId() - firstDoc]) {
+                    list.add(it.docId(), it.frequency());
+                }
+            }
+        }
+        if (!list.empty()) {
+            terms.push_back(keyword);
+            merged.push_back(std::move(list));
+        }
+    }
+
+    size_t liveCount = std::count(live.begin(), live.end(), true);
+    return std::make_shared<Segment>(firstDoc, endDoc, std::move(terms), std::move(merged), liveCount);
+}
+
+const PostingList* Segment::getPostings(TermId keyword) const {
+    auto found = std::lower_bound(terms.begin(), terms.end(), keyword);
+    if (found == terms.end() || *found != keyword) {
+        return nullptr;
+    }
+    const PostingList& list = postings[found - terms.begin()];
+    return list.empty() ? nullptr : &list;
+}
@@ -0,0 +1,55 @@
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include <vector>
+#include <memory>
+#include "termdictionary.h"
+#include "documenttable.h"
+#include "postinglist.h"
+
+class MappedFile;
+
+// An immutable run of postings for the documents in [firstDoc, endDoc).
+// Uploads collect in a small mutable index that is frozen into a segment
+// once it grows past a limit, and runs of similarly sized segments are
+// merged later. DocIds only grow, so segment ranges never overlap and a
+// term's postings, read segment by segment in order, stay sorted.
+//
+// Segments are shared between index copies and snapshots by pointer and
+// never change; merging is also where removed documents finally drop out.
+// Only the terms a segment holds take space in it: their ids are kept
+// sorted beside the lists and looked up by binary search, so a small
+// segment stays small however large the vocabulary is.
+// Segments loaded from a saved index read their postings straight from the
+// mapped file, which they keep open.
+class Segment : public PostingSource {
+private:
+    DocId first;
+    DocId end;
+    std::vector<TermId> terms;         // sorted, one per list in postings
+    std::vector<PostingList> postings; // none of them empty
+    size_t postingTotal;
+    size_t liveDocuments; // live documents in the range when it was built
+    size_t bytes;
+    std::shared_ptr<const MappedFile> file; // the lists point into it, if set
+
+public:
+    // termIds must be strictly increasing, with a list for each
+    Segment(DocId firstDoc, DocId endDoc, std::vector<TermId>&& termIds, std::vector<PostingList>&& termPostings,
+            size_t live, const std::shared_ptr<const MappedFile>& mapping = nullptr);
+
+    // One segment holding the postings of the given adjacent run, minus the
+    // documents not set in live (indexed from the run's first document)
+    static std::shared_ptr<const Segment> merge(const std::vector<std::shared_ptr<const Segment>>& run,
+                                                const std::vector<bool>& live);
+
+    const PostingList* getPostings(TermId keyword) const;
+    std::vector<TermId> termIds() const { return terms; }
+    DocId firstDoc() const { return first; }
+    DocId endDoc() const { return end; }
+    size_t postingCount() const { return postingTotal; }
+    size_t documentCount() const { return liveDocuments; }
+    size_t byteSize() const { return bytes; }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,63 @@
+#include "termdictionary.h"
+#include "utils.h"
+
+TermDictionary::TermDictionary(const TermDictionary& other) {
+    *this = other;
+}
+
+TermDictionary& TermDictionary::operator=(const TermDictionary& other) {
+    if (this != &other) {
+        ids = other.ids;
+        textBytes = other.textBytes;
+        terms.assign(other.terms.size(), nullptr);
+        for (const auto& pair : ids) {
+            terms[pair.second] = &pair.first;
+        }
+    }
+    return *this;
+}
+
+TermId TermDictionary::intern(const std::string& term) {
+    bool inserted;
+    return intern(term, inserted);
+}
+
+TermId TermDictionary::intern(const std::string& term, bool& inserted) {
+    auto it = ids.find(term);
+    if (it != ids.end()) {
+        inserted = false;
+        return it->second;
+    }
+    
+    // Only the first sighting of a term copies it
+    TermId id = static_cast<TermId>(terms.size());
+    it = ids.insert(std::make_pair(term, id)).first;
+    terms.push_back(&it->first);
+    textBytes += Utils::heapBytes(it->first);
+    inserted = true;
+    return id;
+}
+
+TermId TermDictionary::find(const std::string& term) const {
+    auto it = ids.find(term);
+    return it != ids.end() ? it->second : INVALID_TERM;
+}
+
+const std::string& TermDictionary::getTerm(TermId id) const {
+    return *terms[id];
+}
+
+size_t TermDictionary::size() const {
+    return terms.size();
+}
+
+void TermDictionary::clear() {
+    ids.clear();
+    terms.clear();
+    textBytes = 0;
+}
+
+size_t TermDictionary::byteSize() const {
+    return ids.size() * Utils::hashEntryBytes(sizeof(std::pair<const std::string, TermId>)) + textBytes +
+           terms.capacity() * sizeof(const std::string*);
+}
\ No newline at end of file
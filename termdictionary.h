@@ -0,0 +1,35 @@
+#ifndef TERMDICTIONARY_H
+#define TERMDICTIONARY_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+typedef uint32_t TermId;
+
+const TermId INVALID_TERM = 0xFFFFFFFFu;
+
+// Interns every distinct keyword once and hands out dense ids, so the trie,
+// keyword index and topic graph can key on integers instead of strings.
+class TermDictionary {
+private:
+    std::unordered_map<std::string, TermId> ids;
+    std::vector<const std::string*> terms; // points at the keys of ids
+    size_t textBytes;                      // heap bytes of the keys
+
+public:
+    TermDictionary() : textBytes(0) {}
+    TermDictionary(const TermDictionary& other);
+    TermDictionary& operator=(const TermDictionary& other);
+
+    TermId intern(const std::string& term);
+    TermId intern(const std::string& term, bool& inserted);
+    TermId find(const std::string& term) const;
+    const std::string& getTerm(TermId id) const;
+    size_t size() const;
+    void clear();
+    size_t byteSize() const;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "threadpool.h"
+
+ThreadPool::ThreadPool(size_t threads) : active(0), stopping(false) {
+    if (threads == 0) {
+        threads = defaultThreads();
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    available.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::defaultThreads() {
+    unsigned int hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 2;
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push(std::move(task));
+    }
+    available.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return tasks.empty() && active == 0; });
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            available.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop();
+            ++active;
+        }
+        
+        task();
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --active;
+            if (tasks.empty() && active == 0) {
+                idle.notify_all();
+            }
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Fixed set of worker threads draining a shared task queue
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable available;
+    std::condition_variable idle;
+    size_t active;
+    bool stopping;
+    
+    void workerLoop();
+    
+public:
+    explicit ThreadPool(size_t threads = 0); // 0 = one per hardware thread
+    ~ThreadPool();
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    void submit(std::function<void()> task);
+    void wait(); // until every submitted task has finished
+    size_t size() const { return workers.size(); }
+    
+    static size_t defaultThreads();
+};
+
+#endif
\ No newline at end of file
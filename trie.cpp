@@ -1,7 +1,8 @@
 #include "trie.h"
+#include "utils.h"
 #include <iostream>
 
-TrieNode::TrieNode() : isEndOfWord(false) {}
+TrieNode::TrieNode() : termId(INVALID_TERM) {}
 
 TrieNode::~TrieNode() {
     for (auto& pair : children) {
@@ -9,7 +10,7 @@ TrieNode::~TrieNode() {
     }
 }
 
-Trie::Trie() {
+Trie::Trie() : nodes(1) {
     root = new TrieNode();
 }
 
@@ -17,55 +18,63 @@ Trie::~Trie() {
     delete root;
 }
 
-void Trie::insert(const std::string& word) {
+void Trie::insert(const std::string& word, TermId id) {
     TrieNode* current = root;
     for (char c : word) {
         if (current->children.find(c) == current->children.end()) {
             current->children[c] = new TrieNode();
+            ++nodes;
         }
         current = current->children[c];
     }
-    current->isEndOfWord = true;
-    current->word = word;
+    current->termId = id;
 }
 
-void Trie::findAllWords(TrieNode* node, std::vector<std::string>& suggestions) {
-    if (node->isEndOfWord) {
-        suggestions.push_back(node->word);
+void Trie::findAllWords(const TrieNode* node, std::vector<TermId>& suggestions) const {
+    if (node->termId != INVALID_TERM) {
+        suggestions.push_back(node->termId);
     }
     
-    for (auto& pair : node->children) {
+    for (const auto& pair : node->children) {
         findAllWords(pair.second, suggestions);
     }
 }
 
-std::vector<std::string> Trie::autocomplete(const std::string& prefix) {
-    std::vector<std::string> suggestions;
-    TrieNode* current = root;
+std::vector<TermId> Trie::autocomplete(const std::string& prefix) const {
+    std::vector<TermId> suggestions;
+    const TrieNode* current = root;
     
     for (char c : prefix) {
-        if (current->children.find(c) == current->children.end()) {
+        auto child = current->children.find(c);
+        if (child == current->children.end()) {
             return suggestions;
         }
-        current = current->children[c];
+        current = child->second;
     }
     
     findAllWords(current, suggestions);
     return suggestions;
 }
 
-bool Trie::search(const std::string& word) {
-    TrieNode* current = root;
+bool Trie::search(const std::string& word) const {
+    const TrieNode* current = root;
     for (char c : word) {
-        if (current->children.find(c) == current->children.end()) {
+        auto child = current->children.find(c);
+        if (child == current->children.end()) {
             return false;
         }
-        current = current->children[c];
+        current = child->second;
     }
-    return current->isEndOfWord;
+    return current->termId != INVALID_TERM;
 }
 
 void Trie::clear() {
     delete root;
     root = new TrieNode();
+    nodes = 1;
+}
+
+size_t Trie::byteSize() const {
+    // Every node but the root is also an entry in its parent's children
+    return nodes * sizeof(TrieNode) + (nodes - 1) * Utils::hashEntryBytes(sizeof(std::pair<const char, TrieNode*>));
 }
\ No newline at end of file
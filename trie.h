@@ -4,12 +4,12 @@
 #include <unordered_map>
 #include <string>
 #include <vector>
+#include "termdictionary.h"
 
 class TrieNode {
 public:
     std::unordered_map<char, TrieNode*> children;
-    bool isEndOfWord;
-    std::string word;
+    TermId termId; // INVALID_TERM unless a word ends here
     
     TrieNode();
     ~TrieNode();
@@ -18,17 +18,19 @@ public:
 class Trie {
 private:
     TrieNode* root;
+    size_t nodes;
     
-    void findAllWords(TrieNode* node, std::vector<std::string>& suggestions);
+    void findAllWords(const TrieNode* node, std::vector<TermId>& suggestions) const;
     
 public:
     Trie();
     ~Trie();
     
-    void insert(const std::string& word);
-    std::vector<std::string> autocomplete(const std::string& prefix);
-    bool search(const std::string& word);
+    void insert(const std::string& word, TermId id);
+    std::vector<TermId> autocomplete(const std::string& prefix) const;
+    bool search(const std::string& word) const;
     void clear();
+    size_t byteSize() const;
 };
 
 #endif
\ No newline at end of file
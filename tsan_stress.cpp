@@ -0,0 +1,141 @@
+// Concurrent uploads, removals and queries against one engine, built with
+// -fsanitize=thread to check that queries reading a published snapshot of
+// the index never race with writers (see CMakeLists.txt, SEARCH_ENGINE_TSAN).
+//
+// Writers re-upload and remove a rotating set of documents directly, in
+// bulk and through the upload queue, and compact now and then; readers
+// search, search phrases, and ask for related topics, learning paths and
+// snippets the whole time. A set of documents uploaded before the start
+// and never touched must be found by every query, whatever the writers
+// are doing, so a reader seeing half a commit is caught as well as a race.
+// Exits with 1 on a wrong result; ThreadSanitizer fails the run on a race.
+// Files, the index and its log all go to a fresh temporary directory.
+#include "searchengine.h"
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace {
+
+const size_t STABLE_DOCUMENTS = 20;
+const int CHURN_DOCUMENTS = 60;
+const int ROUNDS = 150;
+const int READERS = 4;
+
+std::string churnText(int doc, int round) {
+    std::string text;
+    for (int s = 0; s < 4; ++s) {
+        text += "alpha beta w" + std::to_string((doc * 7 + round + s) % 50) + " topic" +
+                std::to_string((doc + s) % 9) + " round" + std::to_string(round % 5) + ". ";
+    }
+    return text;
+}
+
+} // namespace
+
+int main() {
+    const char* temporary = std::getenv("TMPDIR");
+    std::string pattern = std::string(temporary != nullptr ? temporary : "/tmp") + "/tsan_stressXXXXXX";
+    std::vector<char> path(pattern.begin(), pattern.end());
+    path.push_back('\0');
+    if (mkdtemp(path.data()) == nullptr) {
+        std::cout << "Cannot create a directory from " << pattern << "\n";
+        return 1;
+    }
+    std::string directory(path.data());
+    std::string dataFile = directory + "/search_data.dat";
+    std::string logFile = directory + "/search_data.wal";
+
+    std::atomic<bool> running(true);
+    std::atomic<int> failures(0);
+    std::vector<std::string> bulkFiles;
+    {
+        SearchEngine engine(dataFile, logFile);
+        for (size_t i = 0; i < STABLE_DOCUMENTS; ++i) {
+            engine.uploadFile("stable" + std::to_string(i), "anchor alpha gamma topic" + std::to_string(i % 9) + ".");
+        }
+        for (int i = 0; i < 16; ++i) {
+            std::string name = directory + "/bulk" + std::to_string(i) + ".txt";
+            std::ofstream(name) << churnText(i, i);
+            bulkFiles.push_back(name);
+        }
+
+        std::vector<std::thread> threads;
+        for (int r = 0; r < READERS; ++r) {
+            threads.emplace_back([&engine, &running, &failures, r] {
+                for (int i = 0; running; ++i) {
+                    if (engine.search("anchor", 100).size() != STABLE_DOCUMENTS) {
+                        ++failures;
+                    }
+                    engine.search("alpha w" + std::to_string(i % 50));
+                    engine.searchTerms("beta OR topic" + std::to_string(i % 9));
+                    engine.searchPhrase("alpha beta");
+                    engine.getRelatedTopics("topic" + std::to_string((i + r) % 9));
+                    engine.getLearningPath("alpha");
+                    if (engine.getSnippet("stable" + std::to_string(i % STABLE_DOCUMENTS), "anchor").find("anchor") ==
+                        std::string::npos) {
+                        ++failures;
+                    }
+                }
+            });
+        }
+
+        // Direct uploads and removals of one half of the rotating set
+        std::thread direct([&engine] {
+            for (int round = 0; round < ROUNDS; ++round) {
+                int doc = round % (CHURN_DOCUMENTS / 2);
+                engine.uploadFile("churn" + std::to_string(doc), churnText(doc, round));
+                if (round % 3 == 0) {
+                    engine.removeNote("churn" + std::to_string((doc + 7) % (CHURN_DOCUMENTS / 2)));
+                }
+                if (round % 50 == 49) {
+                    engine.compactIndex();
+                }
+            }
+        });
+        // Queued uploads of the other half, and a bulk upload now and then
+        std::thread queued([&engine, &bulkFiles] {
+            std::vector<JobId> jobs;
+            for (int round = 0; round < ROUNDS; ++round) {
+                int doc = CHURN_DOCUMENTS / 2 + round % (CHURN_DOCUMENTS / 2);
+                JobId job = engine.queueUpload("churn" + std::to_string(doc), churnText(doc, round));
+                if (job != INVALID_JOB) {
+                    jobs.push_back(job);
+                }
+                if (round % 40 == 0) {
+                    engine.uploadNotes(bulkFiles, 3);
+                }
+            }
+            for (JobId job : jobs) {
+                UploadStatus::State state;
+                while ((state = engine.uploadStatus(job).state) == UploadStatus::QUEUED ||
+                       state == UploadStatus::INDEXING) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        direct.join();
+        queued.join();
+        running = false;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    for (const auto& name : bulkFiles) {
+        std::remove(name.c_str());
+    }
+    std::remove(logFile.c_str());
+    rmdir(directory.c_str());
+    if (failures > 0) {
+        std::cout << failures << " queries saw an inconsistent index\n";
+        return 1;
+    }
+    std::cout << "No inconsistent results\n";
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include "uploadqueue.h"
+#include <exception>
+
+const size_t UploadQueue::CAPACITY;
+const size_t UploadQueue::BATCH_SIZE;
+const size_t UploadQueue::HISTORY;
+
+const char* UploadStatus::stateName() const {
+    switch (state) {
+        case QUEUED: return "queued";
+        case INDEXING: return "indexing";
+        case DONE: return "done";
+        case FAILED: return "failed";
+        default: return "unknown";
+    }
+}
+
+UploadQueue::UploadQueue(const Indexer& batchIndexer, size_t maxQueued)
+    : indexer(batchIndexer), capacity(maxQueued), nextId(1), active(0), stopping(false) {
+    worker = std::thread(&UploadQueue::workerLoop, this);
+}
+
+UploadQueue::~UploadQueue() {
+    shutdown();
+}
+
+JobId UploadQueue::submit(const std::string& filename, const std::shared_ptr<const std::string>& content) {
+    JobId id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping || pending.size() >= capacity) {
+            return INVALID_JOB;
+        }
+        id = nextId++;
+        Job job = {id, filename, content};
+        pending.push_back(job);
+
+        UploadStatus& status = jobs[id];
+        status.state = UploadStatus::QUEUED;
+        status.filename = filename;
+    }
+    available.notify_one();
+    return id;
+}
+
+UploadStatus UploadQueue::status(JobId job) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = jobs.find(job);
+    return found != jobs.end() ? found->second : UploadStatus();
+}
+
+size_t UploadQueue::queued() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending.size();
+}
+
+void UploadQueue::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return pending.empty() && active == 0; });
+}
+
+void UploadQueue::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    available.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void UploadQueue::workerLoop() {
+    while (true) {
+        std::vector<AnalyzedDocument> batch;
+        std::vector<JobId> ids;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            available.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (pending.empty()) {
+                return;
+            }
+            while (!pending.empty() && batch.size() < BATCH_SIZE) {
+                Job& job = pending.front();
+                batch.push_back(AnalyzedDocument());
+                batch.back().filename = job.filename;
+                batch.back().content = job.content;
+                ids.push_back(job.id);
+                jobs[job.id].state = UploadStatus::INDEXING;
+                pending.pop_front();
+            }
+            active = batch.size();
+        }
+
+        std::string failure;
+        try {
+            indexer(batch);
+        } catch (const std::exception& e) {
+            failure = e.what();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < batch.size(); ++i) {
+                UploadStatus& status = jobs[ids[i]];
+                status.error = failure.empty() ? batch[i].error : failure;
+                status.state = status.error.empty() ? UploadStatus::DONE : UploadStatus::FAILED;
+                status.keywords = batch[i].length;
+                finished.push_back(ids[i]);
+            }
+            while (finished.size() > HISTORY) {
+                jobs.erase(finished.front());
+                finished.pop_front();
+            }
+            active = 0;
+            if (pending.empty()) {
+                idle.notify_all();
+            }
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef UPLOADQUEUE_H
+#define UPLOADQUEUE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "documentanalyzer.h"
+
+typedef uint64_t JobId;
+
+const JobId INVALID_JOB = 0;
+
+struct UploadStatus {
+    enum State { UNKNOWN, QUEUED, INDEXING, DONE, FAILED };
+
+    State state;
+    std::string filename;
+    uint32_t keywords; // indexed terms, once done
+    std::string error;
+
+    UploadStatus() : state(UNKNOWN), keywords(0) {}
+    const char* stateName() const;
+};
+
+// Bounded queue of uploads indexed by one background thread, so whoever
+// submits an upload gets a job id back at once and polls status() for the
+// outcome. Everything waiting when the thread wakes, up to BATCH_SIZE
+// documents, is handed to the indexer together and costs one index commit.
+class UploadQueue {
+public:
+    // Analyses and commits a batch, setting error on documents that failed
+    typedef std::function<void(std::vector<AnalyzedDocument>&)> Indexer;
+
+    static const size_t CAPACITY = 256;   // queued documents before submit refuses
+    static const size_t BATCH_SIZE = 32;
+    static const size_t HISTORY = 1024;   // finished jobs whose status is kept
+
+private:
+    struct Job {
+        JobId id;
+        std::string filename;
+        std::shared_ptr<const std::string> content; // null: read the file itself
+    };
+
+    Indexer indexer;
+    size_t capacity;
+    std::deque<Job> pending;
+    std::unordered_map<JobId, UploadStatus> jobs;
+    std::deque<JobId> finished; // oldest first, for trimming jobs
+    JobId nextId;
+    size_t active;
+    bool stopping;
+    mutable std::mutex mutex;
+    std::condition_variable available;
+    std::condition_variable idle;
+    std::thread worker;
+
+    void workerLoop();
+
+public:
+    explicit UploadQueue(const Indexer& batchIndexer, size_t maxQueued = CAPACITY);
+    ~UploadQueue();
+
+    UploadQueue(const UploadQueue&) = delete;
+    UploadQueue& operator=(const UploadQueue&) = delete;
+
+    // INVALID_JOB when the queue is full or shutting down
+    JobId submit(const std::string& filename, const std::shared_ptr<const std::string>& content);
+    UploadStatus status(JobId job) const;
+    size_t queued() const;
+    void wait();     // until every job submitted so far has finished
+    void shutdown(); // finishes the queued jobs, then stops the thread
+};
+
+#endif
\ No newline at end of file
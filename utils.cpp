@@ -2,26 +2,93 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <iterator>
 #include <cctype>
 #include <unordered_set>
 #include <regex>
 
+Tokenizer::Tokenizer(const char* text, size_t length)
+    : data(text), size(length), cursor(0), base(0), stream(nullptr), wordStart(0), wordLength(0),
+      wordPosition(0), wordSentence(0), nextPosition(0), nextSentence(0) {}
+
+Tokenizer::Tokenizer(const std::string& text) : Tokenizer(text.data(), text.size()) {}
+
+Tokenizer::Tokenizer(std::istream& input, size_t chunkSize) : Tokenizer(nullptr, 0) {
+    stream = &input;
+    chunk.resize(std::max<size_t>(chunkSize, 1));
+    data = chunk.data();
+}
+
+bool Tokenizer::refill() {
+    // Everything a word needs is carried in the scratch term and the global
+    // offsets, so the previous chunk can be dropped entirely
+    if (stream == nullptr) {
+        return false;
+    }
+    base += size;
+    cursor = 0;
+    stream->read(chunk.data(), chunk.size());
+    size = static_cast<size_t>(stream->gcount());
+    return size > 0;
+}
+
+bool Tokenizer::readWord() {
+    while (true) {
+        while (cursor < size && std::isspace(static_cast<unsigned char>(data[cursor]))) {
+            ++cursor;
+        }
+        if (cursor < size) {
+            break;
+        }
+        if (!refill()) {
+            return false;
+        }
+    }
+
+    wordStart = base + cursor;
+    wordPosition = nextPosition++;
+    wordSentence = nextSentence;
+    current.clear();
+
+    bool endsSentence = false;
+    while (true) {
+        while (cursor < size && !std::isspace(static_cast<unsigned char>(data[cursor]))) {
+            unsigned char c = static_cast<unsigned char>(data[cursor++]);
+            if (c == '.' || c == '!' || c == '?') {
+                endsSentence = true;
+            }
+            // Strip punctuation and fold case in the same pass
+            if (!std::ispunct(c) || c == '_' || c == '-') {
+                current += static_cast<char>(std::tolower(c));
+            }
+        }
+        if (cursor < size || !refill()) {
+            break;
+        }
+    }
+    wordLength = base + cursor - wordStart;
+
+    if (endsSentence) {
+        ++nextSentence;
+    }
+    return true;
+}
+
+bool Tokenizer::next() {
+    while (readWord()) {
+        if (!current.empty() && !Utils::isStopWord(current) && Utils::isImportantWord(current)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 std::vector<std::string> Utils::tokenize(const std::string& text) {
     std::vector<std::string> tokens;
-    std::stringstream ss(text);
-    std::string token;
-    
-    while (ss >> token) {
-        token.erase(std::remove_if(token.begin(), token.end(), 
-                   [](unsigned char c) { 
-                       return std::ispunct(c) && c != '_' && c != '-'; 
-                   }), 
-                   token.end());
-        token = toLowerCase(token);
-        
-        if (!token.empty() && !isStopWord(token) && isImportantWord(token)) {
-            tokens.push_back(token);
-        }
+    Tokenizer tokenizer(text);
+    
+    while (tokenizer.next()) {
+        tokens.push_back(tokenizer.term());
     }
     
     return tokens;
@@ -49,14 +116,41 @@ bool Utils::isStopWord(const std::string& word) {
 }
 
 std::string Utils::readFile(const std::string& filename) {
-    std::ifstream file(filename);
+    std::ifstream file(filename, std::ios::binary);
     if (!file.is_open()) {
         throw std::runtime_error("Cannot open file: " + filename);
     }
     
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
+    // Read straight into a string of the right size instead of going through
+    // a stringstream and copying its buffer out
+    file.seekg(0, std::ios::end);
+    std::streamoff fileSize = file.tellg();
+    file.seekg(0, std::ios::beg);
+    
+    std::string content;
+    if (fileSize < 0) {
+        // Not seekable (a pipe, say): fall back to reading until EOF
+        file.clear();
+        content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    } else if (fileSize > 0) {
+        content.resize(static_cast<size_t>(fileSize));
+        file.read(&content[0], fileSize);
+        content.resize(static_cast<size_t>(file.gcount()));
+    }
+    return content;
+}
+
+std::string Utils::readRange(const std::string& filename, size_t offset, size_t length) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        return std::string();
+    }
+    
+    std::string content(length, '\0');
+    file.seekg(static_cast<std::streamoff>(offset));
+    file.read(&content[0], static_cast<std::streamsize>(length));
+    content.resize(static_cast<size_t>(std::max<std::streamsize>(file.gcount(), 0)));
+    return content;
 }
 
 std::vector<std::string> Utils::splitIntoSentences(const std::string& text) {
@@ -138,6 +232,42 @@ std::string Utils::extractSnippet(const std::string& content, const std::string&
     return "\"" + snippet + "\"";
 }
 
+std::string Utils::extractSnippetAt(const std::string& content, size_t offset, int contextWords) {
+    // Walk outwards from a known hit instead of splitting the whole document
+    auto isSpace = [&content](size_t i) {
+        return std::isspace(static_cast<unsigned char>(content[i])) != 0;
+    };
+    
+    size_t start = std::min(offset, content.size());
+    int wordsBefore = 0;
+    while (wordsBefore < contextWords) {
+        size_t p = start;
+        while (p > 0 && isSpace(p - 1)) --p;
+        if (p == 0) break;
+        while (p > 0 && !isSpace(p - 1)) --p;
+        start = p;
+        ++wordsBefore;
+    }
+    
+    std::string snippet;
+    size_t p = start;
+    for (int i = 0; i < wordsBefore + 1 + contextWords; ++i) {
+        while (p < content.size() && isSpace(p)) ++p;
+        if (p >= content.size()) break;
+        size_t wordStart = p;
+        while (p < content.size() && !isSpace(p)) ++p;
+        snippet.append(content, wordStart, p - wordStart);
+        snippet += " ";
+    }
+    
+    // Clean up the snippet
+    if (snippet.length() > 200) {
+        snippet = snippet.substr(0, 200) + "...";
+    }
+    
+    return "\"" + snippet + "\"";
+}
+
 std::vector<std::string> Utils::extractParagraphs(const std::string& content) {
     std::vector<std::string> paragraphs;
     std::stringstream ss(content);
@@ -153,4 +283,13 @@ std::vector<std::string> Utils::extractParagraphs(const std::string& content) {
     }
     
     return paragraphs;
+}
+
+size_t Utils::heapBytes(const std::string& str) {
+    // Short strings live inside the object
+    const char* begin = reinterpret_cast<const char*>(&str);
+    if (str.data() >= begin && str.data() < begin + sizeof(str)) {
+        return 0;
+    }
+    return str.capacity() + 1;
 }
\ No newline at end of file
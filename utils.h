@@ -3,6 +3,48 @@
 
 #include <string>
 #include <vector>
+#include <cstddef>
+#include <istream>
+
+// Walks a borrowed buffer, or a stream read in fixed-size chunks, once and
+// yields indexable terms. The normalised term lives in a scratch buffer that
+// is reused between calls, so nothing is allocated per token; callers copy
+// term() only when they need to keep it. Offsets are always relative to the
+// start of the whole input, and a word split across two chunks is read as
+// one word.
+class Tokenizer {
+private:
+    const char* data;
+    size_t size;
+    size_t cursor;
+    size_t base;          // input offset of data[0]
+    std::istream* stream; // refills data when set
+    std::vector<char> chunk;
+    std::string current;
+    size_t wordStart;
+    size_t wordLength;
+    size_t wordPosition;
+    size_t wordSentence;
+    size_t nextPosition;
+    size_t nextSentence;
+
+    bool readWord();
+    bool refill();
+
+public:
+    static const size_t CHUNK_SIZE = 64 * 1024;
+    
+    Tokenizer(const char* text, size_t length);
+    explicit Tokenizer(const std::string& text);
+    explicit Tokenizer(std::istream& input, size_t chunkSize = CHUNK_SIZE);
+
+    bool next();
+    const std::string& term() const { return current; }
+    size_t offset() const { return wordStart; }      // byte offset of the raw word
+    size_t length() const { return wordLength; }     // byte length of the raw word
+    size_t position() const { return wordPosition; } // ordinal among all words
+    size_t sentence() const { return wordSentence; } // ordinal of enclosing sentence
+};
 
 class Utils {
 public:
@@ -10,10 +52,18 @@ public:
     static std::string toLowerCase(const std::string& str);
     static bool isStopWord(const std::string& word);
     static std::string readFile(const std::string& filename);
+    static std::string readRange(const std::string& filename, size_t offset, size_t length);
     static std::vector<std::string> splitIntoSentences(const std::string& text);
     static bool isImportantWord(const std::string& word);
     static std::string extractSnippet(const std::string& content, const std::string& keyword, int contextWords = 10);
+    static std::string extractSnippetAt(const std::string& content, size_t offset, int contextWords = 10);
     static std::vector<std::string> extractParagraphs(const std::string& content);
+    
+    // Rough memory accounting: the buffer a string allocates beyond the
+    // object itself, and one entry of a standard unordered container with
+    // its node and bucket overhead
+    static size_t heapBytes(const std::string& str);
+    static size_t hashEntryBytes(size_t valueBytes) { return valueBytes + 3 * sizeof(void*); }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,92 @@
+#ifndef VERSIONED_H
+#define VERSIONED_H
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+// Two copies of a structure, one published to readers and one private to the
+// writer. A write updates the private copy, publishes it, waits for readers
+// still on the old copy to leave, then replays the same update on the old
+// copy so both stay identical. Readers never block and never see a write in
+// progress; every update must therefore be deterministic. A writer waiting
+// for readers sleeps until the last one leaves, which may be a while when a
+// reader holds its copy through a save.
+template <typename T>
+class Versioned {
+private:
+    T copies[2];
+    std::atomic<int> published;
+    mutable std::atomic<long> readers[2];
+    std::mutex writer;
+    std::atomic<bool> draining; // a writer is waiting for the retired copy's readers
+    mutable std::mutex drainLock;
+    mutable std::condition_variable drained;
+    
+    int enter() const {
+        // Retry if a writer flipped the copies between the load and the
+        // registration, because it may not have seen this reader
+        while (true) {
+            int current = published.load();
+            readers[current].fetch_add(1);
+            if (published.load() == current) {
+                return current;
+            }
+            leave(current);
+        }
+    }
+    
+    void leave(int index) const {
+        // The writer sets draining before it checks the count, so either it
+        // sees this reader gone or this reader sees it waiting and wakes it
+        if (readers[index].fetch_sub(1) == 1 && draining.load()) {
+            std::lock_guard<std::mutex> lock(drainLock);
+            drained.notify_all();
+        }
+    }
+    
+public:
+    Versioned() : published(0), draining(false) {
+        readers[0] = 0;
+        readers[1] = 0;
+    }
+    
+    Versioned(const Versioned&) = delete;
+    Versioned& operator=(const Versioned&) = delete;
+    
+    // Pins the published copy for as long as the guard lives
+    class ReadGuard {
+    private:
+        const Versioned& owner;
+        int index;
+        
+    public:
+        explicit ReadGuard(const Versioned& versioned) : owner(versioned), index(versioned.enter()) {}
+        ~ReadGuard() { owner.leave(index); }
+        
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+        
+        const T& operator*() const { return owner.copies[index]; }
+        const T* operator->() const { return &owner.copies[index]; }
+    };
+    
+    template <typename Update>
+    void write(const Update& update) {
+        std::lock_guard<std::mutex> lock(writer);
+        int standby = 1 - published.load();
+        update(copies[standby]);
+        published.store(standby);
+        
+        int retired = 1 - standby;
+        if (readers[retired].load() != 0) {
+            draining.store(true);
+            std::unique_lock<std::mutex> drainGuard(drainLock);
+            drained.wait(drainGuard, [this, retired] { return readers[retired].load() == 0; });
+            draining.store(false);
+        }
+        update(copies[retired]);
+    }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "wand.h"
+#include <algorithm>
+
+WandEvaluator::WandEvaluator(const BM25Scorer& bm25, const DocumentTable& docs)
+    : scorer(bm25), documents(docs) {}
+
+double WandEvaluator::bound(double idf, uint32_t maxFrequency) const {
+    // BM25 grows with frequency and shrinks with length, so the largest
+    // frequency at the shortest length bounds every posting it covers
+    return scorer.score(idf, maxFrequency, documents.minimumLength());
+}
+
+void WandEvaluator::addTerm(const PostingList& postings, double idf) {
+    if (postings.empty()) {
+        return;
+    }
+    cursors.push_back(Cursor(postings, idf, bound(idf, postings.maxFrequency())));
+}
+
+void WandEvaluator::evaluate(TopKHeap& top) {
+    std::vector<Cursor*> order;
+    for (auto& cursor : cursors) {
+        order.push_back(&cursor);
+    }
+    
+    while (true) {
+        std::sort(order.begin(), order.end(),
+                  [](const Cursor* a, const Cursor* b) { return a->docId() < b->docId(); });
+        
+        // Pivot: first cursor at which the summed list bounds beat the threshold
+        double threshold = top.threshold();
+        double listBound = 0.0;
+        size_t pivot = order.size();
+        for (size_t i = 0; i < order.size() && order[i]->docId() != INVALID_DOC; ++i) {
+            listBound += order[i]->upperBound;
+            if (listBound > threshold) {
+                pivot = i;
+                break;
+            }
+        }
+        if (pivot == order.size()) {
+            break;
+        }
+        
+        DocId pivotDoc = order[pivot]->docId();
+        while (pivot + 1 < order.size() && order[pivot + 1]->docId() == pivotDoc) {
+            ++pivot;
+        }
+        
+        // Refine with the bounds of the blocks that hold pivotDoc
+        double blockBound = 0.0;
+        DocId next = pivot + 1 < order.size() ? order[pivot + 1]->docId() : INVALID_DOC;
+        for (size_t i = 0; i <= pivot; ++i) {
+            uint32_t maxFrequency;
+            DocId blockEnd;
+            if (order[i]->it.blockBound(pivotDoc, maxFrequency, blockEnd)) {
+                blockBound += bound(order[i]->idf, maxFrequency);
+                if (blockEnd < next) {
+                    next = blockEnd + 1;
+                }
+            }
+        }
+        
+        if (blockBound <= threshold) {
+            // Nothing before the end of these blocks can make the top k
+            for (size_t i = 0; i <= pivot; ++i) {
+                order[i]->it.advance(next);
+            }
+        } else if (order[0]->docId() == pivotDoc) {
+            double score = 0.0;
+            uint32_t frequency = 0;
+            uint32_t length = documents.getLength(pivotDoc);
+            for (size_t i = 0; i <= pivot; ++i) {
+                score += scorer.score(order[i]->idf, order[i]->it.frequency(), length);
+                frequency += order[i]->it.frequency();
+                order[i]->it.next();
+            }
+            // Tombstoned documents still have postings until compaction
+            if (documents.isLive(pivotDoc)) {
+                top.offer(SearchResult(pivotDoc, frequency, score));
+            }
+        } else {
+            for (size_t i = 0; i < pivot && order[i]->docId() < pivotDoc; ++i) {
+                order[i]->it.advance(pivotDoc);
+            }
+        }
+    }
+}
\ No newline at end of file
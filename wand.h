@@ -0,0 +1,40 @@
+#ifndef WAND_H
+#define WAND_H
+
+#include <vector>
+#include "postinglist.h"
+#include "documenttable.h"
+#include "bm25.h"
+#include "heap.h"
+
+// Block-max WAND top-k evaluation of a disjunctive BM25 query. Each term
+// carries a list-wide score bound and, per block, a bound derived from the
+// block's maximum frequency. A document is only scored when the bounds of the
+// lists that could contain it beat the current top-k threshold; otherwise the
+// cursors jump past it, often a whole block at a time.
+class WandEvaluator {
+private:
+    struct Cursor {
+        PostingList::Iterator it;
+        double idf;
+        double upperBound;
+        
+        Cursor(const PostingList& postings, double termIdf, double bound)
+            : it(postings.iterator()), idf(termIdf), upperBound(bound) {}
+        DocId docId() const { return it.valid() ? it.docId() : INVALID_DOC; }
+    };
+    
+    const BM25Scorer& scorer;
+    const DocumentTable& documents;
+    std::vector<Cursor> cursors;
+    
+    double bound(double idf, uint32_t maxFrequency) const;
+    
+public:
+    WandEvaluator(const BM25Scorer& bm25, const DocumentTable& docs);
+    
+    void addTerm(const PostingList& postings, double idf); // idf over the whole index, not this list
+    void evaluate(TopKHeap& top);
+};
+
+#endif
\ No newline at end of file
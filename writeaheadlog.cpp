@@ -0,0 +1,312 @@
+#include "writeaheadlog.h"
+#include <fstream>
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <stdexcept>
+#include "binaryio.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+const uint32_t WriteAheadLog::FORMAT_VERSION;
+
+namespace {
+
+const char MAGIC[8] = {'S', 'S', 'E', 'U', 'P', 'L', 'O', 'G'};
+const uint32_t ORDER_MARK = 0x01020304;
+const size_t HEADER_SIZE = sizeof(MAGIC) + 2 * sizeof(uint32_t);
+// Each record is its payload length, a checksum of the payload, then the
+// payload: sequence, type, filename and, for uploads, the text if kept
+const size_t RECORD_HEADER = sizeof(uint32_t) + sizeof(uint64_t);
+
+template <typename T> void put(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T> T get(const char*& in, const char* end) {
+    if (static_cast<size_t>(end - in) < sizeof(T)) {
+        throw std::runtime_error("Upload log record is corrupt");
+    }
+    T value;
+    std::memcpy(&value, in, sizeof(T));
+    in += sizeof(T);
+    return value;
+}
+
+std::string header() {
+    std::string bytes(MAGIC, sizeof(MAGIC));
+    put(bytes, WriteAheadLog::FORMAT_VERSION);
+    put(bytes, ORDER_MARK);
+    return bytes;
+}
+
+void encode(const WriteAheadLog::Record& record, uint64_t sequence, std::string& out) {
+    std::string payload;
+    put(payload, sequence);
+    put(payload, static_cast<uint8_t>(record.type));
+    put(payload, static_cast<uint32_t>(record.filename.size()));
+    payload += record.filename;
+    put(payload, static_cast<uint8_t>(record.content ? 1 : 0));
+    if (record.content) {
+        put(payload, static_cast<uint64_t>(record.content->size()));
+        payload += *record.content;
+    }
+
+    put(out, static_cast<uint32_t>(payload.size()));
+    put(out, BinaryWriter::hashBytes(BinaryWriter::HASH_SEED, payload.data(), payload.size()));
+    out += payload;
+}
+
+// Bytes taken by the whole record at in, or 0 if it is torn or fails its checksum
+size_t recordLength(const char* in, size_t available, uint64_t& sequence) {
+    if (available < RECORD_HEADER) {
+        return 0;
+    }
+    uint32_t length;
+    uint64_t checksum;
+    std::memcpy(&length, in, sizeof(length));
+    std::memcpy(&checksum, in + sizeof(length), sizeof(checksum));
+    if (length < sizeof(sequence) || length > available - RECORD_HEADER) {
+        return 0;
+    }
+    const char* payload = in + RECORD_HEADER;
+    if (BinaryWriter::hashBytes(BinaryWriter::HASH_SEED, payload, length) != checksum) {
+        return 0;
+    }
+    std::memcpy(&sequence, payload, sizeof(sequence));
+    return RECORD_HEADER + length;
+}
+
+void decode(const char* in, size_t length, WriteAheadLog::Record& record) {
+    const char* end = in + RECORD_HEADER + length;
+    in += RECORD_HEADER;
+    record.sequence = get<uint64_t>(in, end);
+    record.type = static_cast<WriteAheadLog::Record::Type>(get<uint8_t>(in, end));
+    uint32_t nameLength = get<uint32_t>(in, end);
+    if (nameLength > static_cast<size_t>(end - in)) {
+        throw std::runtime_error("Upload log record is corrupt");
+    }
+    record.filename.assign(in, nameLength);
+    in += nameLength;
+    record.content = nullptr;
+    if (get<uint8_t>(in, end) != 0) {
+        uint64_t textLength = get<uint64_t>(in, end);
+        if (textLength > static_cast<size_t>(end - in)) {
+            throw std::runtime_error("Upload log record is corrupt");
+        }
+        record.content = std::make_shared<const std::string>(in, textLength);
+    }
+}
+
+bool syncDescriptor(int descriptor) {
+#ifdef _WIN32
+    return _commit(descriptor) == 0;
+#else
+    return fsync(descriptor) == 0;
+#endif
+}
+
+} // namespace
+
+WriteAheadLog::WriteAheadLog(const std::string& filename)
+    : path(filename), file(nullptr), size(0), nextSequence(1), syncedSequence(0), syncing(false) {
+    if (path.empty()) {
+        return;
+    }
+    try {
+        recover();
+    } catch (const std::exception& e) {
+        std::cout << "Warning: Could not open " << path << ": " << e.what() << "; uploads are not logged"
+                  << std::endl;
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    if (file != nullptr) {
+        std::fclose(file);
+    }
+}
+
+void WriteAheadLog::recover() {
+    // Keeps what an earlier run left up to the first record that is torn,
+    // fails its checksum or is out of sequence
+    if (!std::ifstream(path).is_open()) {
+        rewrite(nullptr, 0);
+        return;
+    }
+
+    MappedFile existing(path);
+    const char* bytes = existing.data();
+    std::string expected = header();
+    if (existing.size() < HEADER_SIZE || std::memcmp(bytes, expected.data(), HEADER_SIZE) != 0) {
+        throw std::runtime_error("not an upload log of this version and byte order");
+    }
+
+    size_t valid = HEADER_SIZE;
+    uint64_t last = 0;
+    uint64_t sequence;
+    while (size_t length = recordLength(bytes + valid, existing.size() - valid, sequence)) {
+        if (sequence <= last) {
+            break;
+        }
+        last = sequence;
+        valid += length;
+    }
+
+    if (valid < existing.size()) {
+        std::cout << "Warning: Dropped a damaged record at the end of " << path << std::endl;
+        rewrite(bytes + HEADER_SIZE, valid - HEADER_SIZE);
+    } else {
+        file = std::fopen(path.c_str(), "ab");
+        if (file == nullptr) {
+            throw std::runtime_error("Cannot open file: " + path);
+        }
+        size = valid;
+    }
+    nextSequence = last + 1;
+    syncedSequence = last;
+}
+
+void WriteAheadLog::rewrite(const char* records, size_t length) {
+    // A new file with the given records is synced and renamed over the log,
+    // so a crash part way leaves either the old records or the new ones
+    std::string temporary = path + ".tmp";
+    try {
+        BinaryWriter out(temporary);
+        std::string bytes = header();
+        out.writeBytes(bytes.data(), bytes.size());
+        if (length > 0) {
+            out.writeBytes(records, length);
+        }
+        out.close();
+    } catch (...) {
+        std::remove(temporary.c_str());
+        throw;
+    }
+
+    if (file != nullptr) {
+        std::fclose(file); // Windows cannot replace a file that is open
+        file = nullptr;
+    }
+    bool replaced = std::rename(temporary.c_str(), path.c_str()) == 0 ||
+                    (std::remove(path.c_str()) == 0 && std::rename(temporary.c_str(), path.c_str()) == 0);
+    file = std::fopen(path.c_str(), "ab");
+    if (!replaced || file == nullptr) {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Cannot replace " + path);
+    }
+    size = HEADER_SIZE + length;
+}
+
+void WriteAheadLog::waitForSync(std::unique_lock<std::mutex>& lock) {
+    synced.wait(lock, [this] { return !syncing; });
+}
+
+uint64_t WriteAheadLog::append(const std::vector<Record>& records) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (file == nullptr || records.empty()) {
+        return 0;
+    }
+
+    std::string bytes;
+    for (size_t i = 0; i < records.size(); ++i) {
+        encode(records[i], nextSequence + i, bytes);
+    }
+    if (std::fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size()) {
+        // Records after a torn one would be dropped on recovery, so the log
+        // stops here rather than accept uploads it cannot replay
+        std::fclose(file);
+        file = nullptr;
+        throw std::runtime_error("Cannot write " + path + "; uploads are no longer logged");
+    }
+    size += bytes.size();
+    nextSequence += records.size();
+    return nextSequence - 1;
+}
+
+void WriteAheadLog::sync(uint64_t sequence) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (file != nullptr && syncedSequence < sequence) {
+        if (syncing) {
+            synced.wait(lock);
+            continue;
+        }
+
+        // Everything appended so far goes out with this one fsync, and the
+        // mutex is free meanwhile for others to append and queue up
+        uint64_t target = nextSequence - 1;
+        bool failed = std::fflush(file) != 0;
+        int descriptor = fileno(file);
+        syncing = true;
+        lock.unlock();
+        failed = !syncDescriptor(descriptor) || failed;
+        lock.lock();
+        syncing = false;
+        synced.notify_all();
+        if (failed) {
+            throw std::runtime_error("Cannot sync " + path);
+        }
+        syncedSequence = std::max(syncedSequence, target);
+    }
+}
+
+uint64_t WriteAheadLog::position() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return size;
+}
+
+void WriteAheadLog::discardBefore(uint64_t offset) {
+    std::unique_lock<std::mutex> lock(mutex);
+    waitForSync(lock); // the file is about to be swapped
+    if (file == nullptr || offset <= HEADER_SIZE) {
+        return;
+    }
+    if (std::fflush(file) != 0) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+
+    // Usually nothing was appended while saving and the log starts over
+    if (offset >= size) {
+        rewrite(nullptr, 0);
+    } else {
+        MappedFile current(path);
+        if (current.size() < size) {
+            throw std::runtime_error("Cannot read " + path);
+        }
+        rewrite(current.data() + offset, size - offset);
+    }
+    syncedSequence = nextSequence - 1; // whatever is left was just synced
+}
+
+void WriteAheadLog::replay(uint64_t after, const std::function<void(const Record&)>& apply) {
+    std::unique_lock<std::mutex> lock(mutex);
+    nextSequence = std::max(nextSequence, after + 1);
+    syncedSequence = std::max(syncedSequence, after);
+    if (file == nullptr || size <= HEADER_SIZE) {
+        return;
+    }
+    if (std::fflush(file) != 0) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+    size_t end = size;
+    MappedFile current(path);
+    lock.unlock();
+
+    Record record;
+    uint64_t sequence;
+    for (size_t offset = HEADER_SIZE; offset < end;) {
+        size_t length = recordLength(current.data() + offset, end - offset, sequence);
+        if (length == 0) {
+            throw std::runtime_error("Upload log record is corrupt");
+        }
+        if (sequence > after) {
+            decode(current.data() + offset, length - RECORD_HEADER, record);
+            apply(record);
+        }
+        offset += length;
+    }
+}
\ No newline at end of file
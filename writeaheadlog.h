@@ -0,0 +1,79 @@
+#ifndef WRITEAHEADLOG_H
+#define WRITEAHEADLOG_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+
+// Append-only log of the uploads and removals made since the last saved
+// index, so they survive a crash without saving the whole index each time.
+// append() numbers records and buffers them; sync() makes them durable.
+// Whoever syncs first flushes everything appended so far with one fsync,
+// and callers that appended in the meantime wait for that instead of
+// syncing again, so concurrent uploads share the cost (group commit).
+//
+// Every record carries its sequence number and a checksum. A torn record at
+// the end, left by a crash in the middle of a write, is cut off when the
+// log is opened. A log that cannot be opened is reported once and then
+// ignored: uploads still work, they are just not durable until saved.
+class WriteAheadLog {
+public:
+    struct Record {
+        enum Type : uint8_t { ADD = 1, REMOVE = 2 };
+
+        uint64_t sequence;
+        Type type;
+        std::string filename;
+        std::shared_ptr<const std::string> content; // ADD only; null: read the file itself
+
+        Record() : sequence(0), type(ADD) {}
+        Record(Type kind, const std::string& name, const std::shared_ptr<const std::string>& text = nullptr)
+            : sequence(0), type(kind), filename(name), content(text) {}
+    };
+
+    static const uint32_t FORMAT_VERSION = 1;
+
+private:
+    std::string path;
+    std::FILE* file; // null if the log could not be opened
+    uint64_t size;   // valid bytes in the file, header included
+    uint64_t nextSequence;
+    uint64_t syncedSequence;
+    bool syncing;
+    std::mutex mutex;
+    std::condition_variable synced;
+
+    void recover();
+    void rewrite(const char* records, size_t length);
+    void waitForSync(std::unique_lock<std::mutex>& lock);
+
+public:
+    // An empty filename gives a log that is never open
+    explicit WriteAheadLog(const std::string& filename);
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    bool isOpen() const { return file != nullptr; }
+    // The sequence of the last record, or 0 if there were none or the log
+    // is not open. Throws std::runtime_error if the write fails.
+    uint64_t append(const std::vector<Record>& records);
+    // Returns once every record up to sequence is on disk
+    void sync(uint64_t sequence);
+    // Bytes appended so far; a saved index covering everything appended
+    // before some position lets discardBefore() drop those records
+    uint64_t position();
+    void discardBefore(uint64_t offset);
+
+    // Hands every record after the given sequence to apply, in order, and
+    // numbers records appended from now on after both
+    void replay(uint64_t after, const std::function<void(const Record&)>& apply);
+};
+
+#endif